@@ -0,0 +1,18 @@
+#ifndef ADCSCAN_H_   /* Include guard */
+#define ADCSCAN_H_
+
+// Max channels in 1 scan sequence (not counting the internal VREFINT/temperature channels used for calibration)
+#define ADCSCAN_MAX_CHANNELS (8)
+
+// Get the ADC input channel for a gpio (add 16 for group B etc), -1 if the pin has no ADC input
+int adcscan_gpioToChannel(int8_t gpio);
+// Convert the channels in 1 DMA driven scan, each oversampled (see MIO_ADC_OVERSAMPLE_LOG2). The calling task sleeps until the DMA 
+// is complete. Results are the averages, with MIO_ADC_EXTRA_BITS more bits than the 12 bit ADC, or in mV if MIO_ADC_CALIBRATE.
+// Returns false if the scan failed.
+bool adcscan_read(const uint8_t* chans, int nbChans, uint16_t* results);
+// Supply voltage in mV measured by the last calibrated scan (0 if none)
+uint16_t adcscan_getVDDA();
+// MCU temperature in 1/10 degC measured by the last calibrated scan (if MIO_ADC_MCU_TEMP)
+int16_t adcscan_getMCUTemp();
+
+#endif
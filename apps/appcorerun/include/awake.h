@@ -0,0 +1,27 @@
+#ifndef AWAKE_H_   /* Include guard */
+#define AWAKE_H_
+
+#include <stdint.h>
+
+// Activities that keep the device awake, whose time is accounted
+typedef enum { AWAKE_ONEWIRE=0, AWAKE_ADC, AWAKE_USDIST, AWAKE_PWM, AWAKE_LOG, AWAKE_START, AWAKE_NB } AWAKE_SUBSYS;
+
+// Current time in us for timing an activity
+uint64_t awake_now();
+// Add time in us to an activity that runs in the background (eg a burst ended by interrupts)
+void awake_add(AWAKE_SUBSYS s, uint32_t us);
+// Make s the activity the cpu time of the calling task goes to, returns the previous one to give to awake_leave(). Task 
+// context only
+AWAKE_SUBSYS awake_enter(AWAKE_SUBSYS s);
+void awake_leave(AWAKE_SUBSYS prev);
+// Time a statement : an activity timed inside it gets its own time, so the activities don't overlap
+#define AWAKE_TIMED(s, x) do { AWAKE_SUBSYS __awakeP = awake_enter(s); x; awake_leave(__awakeP); } while(0)
+// Total time in us and number of times each activity was done since boot (or reset)
+uint64_t awake_getUS(AWAKE_SUBSYS s);
+uint32_t awake_getCount(AWAKE_SUBSYS s);
+const char* awake_getName(AWAKE_SUBSYS s);
+// Estimated charge used by the activities in uAh, from their currents (MIO_AWAKE_CURRENTS_UA)
+uint32_t awake_getChargeUAH();
+void awake_reset();
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef BOOTTIME_H_   /* Include guard */
+#define BOOTTIME_H_
+
+// Max boot phases recorded
+#define BOOTTIME_MAX (8)
+
+// Record the end of a boot phase (can be called before sysinit). The first call starts the timing.
+void boottime_mark(const char* phase);
+// Log the time of each recorded phase since the first one, in ms
+void boottime_log();
+
+#endif
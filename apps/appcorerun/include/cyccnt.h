@@ -0,0 +1,35 @@
+#ifndef CYCCNT_H_   /* Include guard */
+#define CYCCNT_H_
+
+// Cortex-M3 DWT cycle counter : cpu clock cycles, wraps every ~2 mins at 32MHz. Only counts while the cpu is running (not in sleep)
+#ifdef ARCH_sim
+#include "os/os.h"
+// no DWT on the sim : use the uptime in us, as a 1MHz 'cpu'
+static inline void cyccnt_init() {
+}
+static inline uint32_t cyccnt_get() {
+    return (uint32_t)os_get_uptime_usec();
+}
+static inline uint32_t cyccnt_perUS() {
+    return 1;
+}
+#else
+#include "stm32l1xx_hal.h"
+static inline void cyccnt_init() {
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)==0) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+}
+static inline uint32_t cyccnt_get() {
+    return DWT->CYCCNT;
+}
+// cycles per us at the current clock
+static inline uint32_t cyccnt_perUS() {
+    uint32_t c = SystemCoreClock/1000000;
+    return (c>0)?c:1;
+}
+#endif
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef MIO_CONSOLE_H_   /* Include guard */
+#define MIO_CONSOLE_H_
+
+// Register the mod-io diagnostic commands with the mynewt shell (if MIO_SHELL_CMDS)
+void mio_console_init();
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MIO_LOG_H_   /* Include guard */
+#define MIO_LOG_H_
+
+#include <stdint.h>
+#include "wyres-generic/wutils.h"
+
+// log levels of the mod-io log calls (the _LVL defines are for the preprocessor)
+#define MIO_LL_DEBUG_LVL (0)
+#define MIO_LL_INFO_LVL (1)
+#define MIO_LL_WARN_LVL (2)
+#define MIO_LL_ERROR_LVL (3)
+typedef enum { MIO_LL_DEBUG=MIO_LL_DEBUG_LVL, MIO_LL_INFO=MIO_LL_INFO_LVL, MIO_LL_WARN=MIO_LL_WARN_LVL, MIO_LL_ERROR=MIO_LL_ERROR_LVL } MIO_LOG_LEVEL_t;
+
+// number of args (0 to 10) of a variadic macro
+#define MIO_NARGS(...) MIO_NARGS_(0, ##__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define MIO_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, N, ...) N
+
+#if MYNEWT_VAL(MIO_BINARY_LOG)
+// Deferred binary log : the call only copies the format string address and the raw args (int sized, max 10) into a RAM ring.
+// The ring is written out as hex later (mio_blog_drain), and tools/mio_blog.py rebuilds the text from the format strings in the elf.
+// %s args must point to constant strings (they are read from the elf too).
+#define MIO_BLOG(lvl, fmt, ...) do { \
+        static const char __attribute__((section(".rodata.mio_blog"))) __mioFmt[] = fmt; \
+        mio_blog_push((lvl), __mioFmt, MIO_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+    } while(0)
+#define MIO_LOG_DEBUG_(fmt, ...) MIO_BLOG(MIO_LL_DEBUG, fmt, ##__VA_ARGS__)
+#define MIO_LOG_INFO_(fmt, ...) MIO_BLOG(MIO_LL_INFO, fmt, ##__VA_ARGS__)
+#define MIO_LOG_WARN_(fmt, ...) MIO_BLOG(MIO_LL_WARN, fmt, ##__VA_ARGS__)
+#define MIO_LOG_ERROR_(fmt, ...) MIO_BLOG(MIO_LL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define MIO_LOG_DEBUG_(...) log_debug(__VA_ARGS__)
+#define MIO_LOG_INFO_(...) log_info(__VA_ARGS__)
+#define MIO_LOG_WARN_(...) log_warn(__VA_ARGS__)
+#define MIO_LOG_ERROR_(...) log_error(__VA_ARGS__)
+#endif
+
+// Compile time log level (MIO_LOG_LEVEL) : the calls below it are removed with their format strings and arg marshalling.
+// They are still type checked, and the variables only used in logs do not become unused.
+#define MIO_LOG_STRIPPED(...) do { if (0) { log_noout(__VA_ARGS__); } } while(0)
+#if MYNEWT_VAL(MIO_LOG_LEVEL)<=MIO_LL_DEBUG_LVL
+#define MIO_LOG_DEBUG MIO_LOG_DEBUG_
+#else
+#define MIO_LOG_DEBUG MIO_LOG_STRIPPED
+#endif
+#if MYNEWT_VAL(MIO_LOG_LEVEL)<=MIO_LL_INFO_LVL
+#define MIO_LOG_INFO MIO_LOG_INFO_
+#else
+#define MIO_LOG_INFO MIO_LOG_STRIPPED
+#endif
+#if MYNEWT_VAL(MIO_LOG_LEVEL)<=MIO_LL_WARN_LVL
+#define MIO_LOG_WARN MIO_LOG_WARN_
+#else
+#define MIO_LOG_WARN MIO_LOG_STRIPPED
+#endif
+#if MYNEWT_VAL(MIO_LOG_LEVEL)<=MIO_LL_ERROR_LVL
+#define MIO_LOG_ERROR MIO_LOG_ERROR_
+#else
+#define MIO_LOG_ERROR MIO_LOG_STRIPPED
+#endif
+
+void mio_log_init();
+void mio_blog_push(uint8_t lvl, const char* fmt, int nargs, ...);
+// Write out the pending binary log records, returns the number written
+int mio_blog_drain();
+// Number of records lost as the ring was full
+uint32_t mio_blog_getLost();
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef MIO_TRACE_H_   /* Include guard */
+#define MIO_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Field trace of the mod-io events (MIO_TRACE) : compact binary records in a RAM ring, written out as 'TR:' hex lines and 
+// decoded / replayed in the sim on the host by tools/mio_trace.py.
+// Record : (type<<4 | io id), time since the previous record in ms (varint), then the data of the type
+typedef enum { TR_START=0, TR_BUTTON, TR_STATE, TR_SAMPLE, TR_NOSAMPLE, TR_DL, TR_UL } MIO_TRACE_TYPE_t;
+
+void mio_trace_init();
+// button or state input callback : its state, and the press type for a button release
+void mio_trace_input(MIO_TRACE_TYPE_t type, int ioid, uint8_t state, uint8_t pressType);
+// value read from an io, or no valid reading (sensor not answering)
+void mio_trace_sample(int ioid, int32_t value, bool valid);
+// DL action received (first MIO_TRACE_UL_MAX bytes kept)
+void mio_trace_dl(uint8_t action, uint8_t* v, uint8_t l);
+// UL data of mod-io : each TLV as it is added, then the record at the end of the UL (its size, and its first MIO_TRACE_UL_MAX bytes)
+void mio_trace_ulTLV(uint8_t t, uint8_t l, void* v);
+void mio_trace_ulEnd();
+// Write out the pending records, returns the number written
+int mio_trace_drain();
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MIOPROF_H_   /* Include guard */
+#define MIOPROF_H_
+
+#include <stdint.h>
+
+// Profiled code sites
+typedef enum { PROF_READIOS=0, PROF_GETDATA, PROF_IOSET, PROF_BUTTON_CB, PROF_STATE_CB, 
+                PROF_READ_DIN, PROF_READ_AIN, PROF_READ_DS18B20, PROF_READ_COUNTER, PROF_READ_FREQ, PROF_READ_USDIST, 
+                PROF_NB_SITES } PROF_SITE;
+
+// cycle count stats of a site
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t mean;
+} PROF_STATS_t;
+
+#if MYNEWT_VAL(MIO_PROFILING)
+#include "cyccnt.h"
+// Time the code between PROF_START and PROF_END in cpu cycles (DWT), with the stats per site. Compiled out without MIO_PROFILING
+#define PROF_START(v) uint32_t v = cyccnt_get()
+#define PROF_END(site, v) mioprof_record((site), cyccnt_get()-(v))
+#else
+#define PROF_START(v) 
+#define PROF_END(site, v) do {} while(0)
+#endif
+
+void mioprof_init();
+void mioprof_record(PROF_SITE site, uint32_t cycles);
+// false if the site was never run
+bool mioprof_getStats(PROF_SITE site, PROF_STATS_t* stats);
+const char* mioprof_getName(PROF_SITE site);
+void mioprof_reset();
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef PINPARK_H_   /* Include guard */
+#define PINPARK_H_
+
+#include <hal/hal_gpio.h>
+
+// Max unused pins that can be parked
+#define PINPARK_MAX (16)
+
+// Add an unused pin to park in analog mode when going to sleep, where it stays. Must not be a pin that a driver or the 
+// GPIO manager owns, as they don't expect it to change under them
+bool pinpark_define(int8_t gpio);
+// Put now a pin that its driver sets up again before each use (eg 1-Wire) in its lowest leakage state : analog mode, or 
+// an input with the given pull if parking is not enabled, rather than left floating
+void pinpark_idle(int8_t gpio, hal_gpio_pull_t pull);
+// Park the defined pins, and switch off the ADC if it was left on
+void pinpark_parkAll();
+// Put back the ADC as it was
+void pinpark_restoreAll();
+// Log the state of every pin and of the ADC/HSI, with the likely leakage sources : floating inputs, pulls driven against
+void pinpark_report();
+
+#endif
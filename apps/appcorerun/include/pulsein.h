@@ -0,0 +1,23 @@
+#ifndef PULSEIN_H_   /* Include guard */
+#define PULSEIN_H_
+
+#include <hal/hal_gpio.h>
+
+// Max number of pulse inputs (1 per mod-io channel)
+#define PULSEIN_MAX (8)
+
+// Count falling edges on a gpio by interrupt, ignoring any edge less than debounceMS after the last counted one
+bool pulsein_defineCounter(int id, int8_t gpio, hal_gpio_pull_t pull, uint32_t debounceMS);
+// Total edges counted since init (wraps at 2^32)
+uint32_t pulsein_getCount(int id);
+// Measure the period of a signal on a gpio : falling edges are timestamped by interrupt only while the gate is open
+bool pulsein_defineFreq(int id, int8_t gpio, hal_gpio_pull_t pull);
+// Called from the default event queue task when the gate closes
+typedef void (*PULSEIN_DONE_CB_t)(int id);
+// Open the gate for gateMS, the result is available when it closes (doneCB may be NULL). 
+// Returns false if the gate could not be opened (bad id, or a gate already running)
+bool pulsein_startFreq(int id, uint32_t gateMS, PULSEIN_DONE_CB_t doneCB);
+// Mean period in us over the last completed gate, 0 if less than 2 edges were seen
+uint32_t pulsein_getPeriodUS(int id);
+
+#endif
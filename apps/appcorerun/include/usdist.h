@@ -0,0 +1,18 @@
+#ifndef USDIST_H_   /* Include guard */
+#define USDIST_H_
+
+#include <hal/hal_gpio.h>
+
+// Ultrasonic distance sensor (HC-SR04 type) : a pulse on the trigger pin starts a ping, the echo pin is then high for the time 
+// of flight of the sound there and back.
+// Result callback, called from the default event queue task with the echo time in us (0 if no valid echo)
+typedef void (*USDIST_CB_t)(void* ctx, uint32_t echoUS);
+// Start a burst of nbPings in the background, the echo time is the mean of the pings close to the median. 
+// The whole burst takes at most MIO_USDIST_MAX_MS. Returns false if a burst is already running.
+bool usdist_startMeasure(int8_t trig, int8_t echo, hal_gpio_pull_t echoPull, int nbPings, USDIST_CB_t cb, void* cbCtx);
+// Echo time in us of the last completed burst, 0 if no valid echo
+uint32_t usdist_getEchoUS();
+// Convert an echo time to a distance in mm, with the speed of sound at the air temperature given in 1/16 degC
+uint32_t usdist_echoToMM(uint32_t echoUS, int32_t temp16);
+
+#endif
@@ -12,12 +12,15 @@ bool ds18B20_broadcastConvert(int8_t pin) {
   }
   onewireWriteByte(pin, 0xCC);
   onewireWriteByte(pin, 0x44);
+  // Don't wait for the end of the conversion, caller polls or waits for the conversion time
+  return true;
+}
 
-  for(int i=0;i<10000;i++) {
-    if (onewireReadBit(pin))
-      return true;
-  }
-  return false;   // badness on the line...
+/*
+  check if the conversion is finished (sensors hold the line low while converting)
+*/
+bool ds18B20_isConversionDone(int8_t pin) {
+  return (onewireReadBit(pin)!=0);
 }
 
 /*
@@ -40,7 +43,7 @@ float ds18B20_getTemperature(int8_t pin, unsigned char* address) {
       scratchPad[i] = onewireReadByte(pin);
     }
     onewireInit(pin);
-    temperature = ((scratchPad[1] * 256) + scratchPad[0])*0.0625;
+    temperature = ((int16_t)((scratchPad[1] * 256) + scratchPad[0]))*0.0625;
 
     return temperature;
   } else {
@@ -66,7 +69,8 @@ int ds18B20_getTemperatureInt(int8_t pin, unsigned char* address) {
       scratchPad[i] = onewireReadByte(pin);
     }
     onewireInit(pin);
-    temperature = ((scratchPad[1] * 256) + scratchPad[0]);
+    // signed 16 bits value
+    temperature = (int16_t)((scratchPad[1] * 256) + scratchPad[0]);
 
     return temperature;
   } else {
@@ -0,0 +1,229 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Multichannel ADC scan for the STM32L1 : all the channels are converted as 1 regular sequence, repeated for the oversampling, 
+ * with the results transferred by DMA while the task sleeps.
+ * The ADC is completely setup for each scan and released after, as other users (gpiomgr) may use it between scans.
+ * With calibration, the internal reference (VREFINT) is converted in the same sequence, so the results can be given in mV whatever
+ * the battery voltage, using the factory calibration value stored in the system memory.
+ */
+#include "os/os.h"
+
+#include "adcscan.h"
+
+#if MYNEWT_VAL(MIO_ADC_SCAN)
+
+#include "stm32l1xx_hal.h"
+
+#define OVERSAMPLE_LOG2 (MYNEWT_VAL(MIO_ADC_OVERSAMPLE_LOG2))
+#define OVERSAMPLE (1<<OVERSAMPLE_LOG2)
+#define EXTRA_BITS (MYNEWT_VAL(MIO_ADC_EXTRA_BITS))
+// the extra bits are taken from the sum of the samples (shift by OVERSAMPLE_LOG2-EXTRA_BITS), and the mV scaling of a 
+// (12+EXTRA_BITS) bits value must fit in 32 bits
+#if OVERSAMPLE_LOG2<0 || OVERSAMPLE_LOG2>8
+#error "MIO_ADC_OVERSAMPLE_LOG2 must be 0 to 8"
+#endif
+#if EXTRA_BITS<0 || EXTRA_BITS>(OVERSAMPLE_LOG2/2)
+#error "MIO_ADC_EXTRA_BITS must be 0 to MIO_ADC_OVERSAMPLE_LOG2/2"
+#endif
+// max time for a scan before we decide its broken
+#define SCAN_TIMEOUT_MS (100)
+
+#define CALIBRATE (MYNEWT_VAL(MIO_ADC_CALIBRATE))
+#define MCU_TEMP (MYNEWT_VAL(MIO_ADC_MCU_TEMP))
+// Factory calibration values (12 bits, measured at VDDA=3.0V) : addresses for STM32L1 cat 3 devices (eg STM32L151CC)
+#define VREFINT_CAL (*((uint16_t*)0x1FF800F8))
+#define TS_CAL1 (*((uint16_t*)0x1FF800FA))      // at 30 degC
+#define TS_CAL2 (*((uint16_t*)0x1FF800FE))      // at 110 degC
+#define CAL_VDDA_MV (3000)
+#define ADC_FULLSCALE (4095)
+// internal channels added after the user ones
+#define NB_INTERNAL_CHANS ((CALIBRATE?1:0)+((CALIBRATE && MCU_TEMP)?1:0))
+
+static ADC_HandleTypeDef _hadc;
+static DMA_HandleTypeDef _hdma;
+static struct os_sem _scanDone;
+static bool _init = false;
+// each sequence is written one after the other : results for channel i are at i, i+nbChans, i+2*nbChans...
+static uint16_t _buf[(ADCSCAN_MAX_CHANNELS+NB_INTERNAL_CHANS)*OVERSAMPLE];
+static uint16_t _vddaMV = 0;
+static int16_t _mcuTemp = 0;
+
+static void adcscan_dma_irq(void) {
+    bool done = (__HAL_DMA_GET_FLAG(&_hdma, DMA_FLAG_TC1) || __HAL_DMA_GET_FLAG(&_hdma, DMA_FLAG_TE1));
+    // always clear all the flags of the channel, or any other one (eg half transfer) would fire the irq again and again
+    __HAL_DMA_CLEAR_FLAG(&_hdma, DMA_FLAG_GL1);
+    if (done) {
+        os_sem_release(&_scanDone);
+    }
+}
+
+int adcscan_gpioToChannel(int8_t gpio) {
+    if (gpio>=0 && gpio<=7) {
+        return gpio;                // PA0-7 : IN0-7
+    }
+    if (gpio==16 || gpio==17) {
+        return gpio-16+8;           // PB0-1 : IN8-9
+    }
+    if (gpio>=28 && gpio<=31) {
+        return gpio-28+18;          // PB12-15 : IN18-21
+    }
+    if (gpio>=32 && gpio<=37) {
+        return gpio-32+10;          // PC0-5 : IN10-15
+    }
+    return -1;
+}
+
+bool adcscan_read(const uint8_t* chans, int nbChans, uint16_t* results) {
+    if (nbChans<=0 || nbChans>ADCSCAN_MAX_CHANNELS) {
+        return false;
+    }
+    if (!_init) {
+        os_sem_init(&_scanDone, 0);
+        NVIC_SetVector(DMA1_Channel1_IRQn, (uint32_t)adcscan_dma_irq);
+        NVIC_SetPriority(DMA1_Channel1_IRQn, 3);
+        _init = true;
+    }
+    // ADC runs on the HSI, which may be off
+    bool hsiWasOn = __HAL_RCC_GET_FLAG(RCC_FLAG_HSIRDY);
+    if (!hsiWasOn) {
+        __HAL_RCC_HSI_ENABLE();
+        while(!__HAL_RCC_GET_FLAG(RCC_FLAG_HSIRDY)) {
+            ;
+        }
+    }
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    // Sequence of all the channels, repeated continuously until the DMA buffer is full
+    _hadc.Instance = ADC1;
+    _hadc.Init.ClockPrescaler = ADC_CLOCK_ASYNC_DIV1;
+    _hadc.Init.Resolution = ADC_RESOLUTION_12B;
+    _hadc.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    _hadc.Init.ScanConvMode = ADC_SCAN_ENABLE;
+    _hadc.Init.EOCSelection = ADC_EOC_SEQ_CONV;
+    _hadc.Init.LowPowerAutoWait = ADC_AUTOWAIT_DISABLE;
+    _hadc.Init.LowPowerAutoPowerOff = ADC_AUTOPOWEROFF_DISABLE;
+    _hadc.Init.ChannelsBank = ADC_CHANNELS_BANK_A;
+    _hadc.Init.ContinuousConvMode = ENABLE;
+    int nbConvs = nbChans+NB_INTERNAL_CHANS;
+    _hadc.Init.NbrOfConversion = nbConvs;
+    _hadc.Init.DiscontinuousConvMode = DISABLE;
+    _hadc.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+    _hadc.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
+    _hadc.Init.DMAContinuousRequests = DISABLE;
+    if (HAL_ADC_Init(&_hadc)!=HAL_OK) {
+        if (!hsiWasOn) {
+            __HAL_RCC_HSI_DISABLE();
+        }
+        return false;
+    }
+    for(int i=0;i<nbConvs;i++) {
+        ADC_ChannelConfTypeDef cc = {
+            .Channel = (i<nbChans)?chans[i]:((i==nbChans)?ADC_CHANNEL_VREFINT:ADC_CHANNEL_TEMPSENSOR),
+            .Rank = ADC_REGULAR_RANK_1+i,
+            // internal channels need a longer sampling time (min 4us)
+            .SamplingTime = (i<nbChans)?ADC_SAMPLETIME_96CYCLES:ADC_SAMPLETIME_384CYCLES,
+        };
+        if (HAL_ADC_ConfigChannel(&_hadc, &cc)!=HAL_OK) {
+            HAL_ADC_DeInit(&_hadc);
+            if (!hsiWasOn) {
+                __HAL_RCC_HSI_DISABLE();
+            }
+            return false;
+        }
+    }
+    _hdma.Instance = DMA1_Channel1;
+    _hdma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    _hdma.Init.PeriphInc = DMA_PINC_DISABLE;
+    _hdma.Init.MemInc = DMA_MINC_ENABLE;
+    _hdma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    _hdma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    _hdma.Init.Mode = DMA_NORMAL;
+    _hdma.Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&_hdma);
+    __HAL_LINKDMA(&_hadc, DMA_Handle, _hdma);
+    NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+    // Go, and sleep until the DMA says its done
+    bool ret = false;
+    if (HAL_ADC_Start_DMA(&_hadc, (uint32_t*)&_buf[0], nbConvs*OVERSAMPLE)==HAL_OK) {
+        // the HAL enables the half transfer interrupt too, we only want the end
+        __HAL_DMA_DISABLE_IT(&_hdma, DMA_IT_HT);
+        ret = (os_sem_pend(&_scanDone, os_time_ms_to_ticks32(SCAN_TIMEOUT_MS))==OS_OK);
+        HAL_ADC_Stop_DMA(&_hadc);
+    }
+    NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+    HAL_DMA_DeInit(&_hdma);
+    HAL_ADC_DeInit(&_hadc);
+    __HAL_RCC_ADC1_CLK_DISABLE();
+    if (!hsiWasOn) {
+        __HAL_RCC_HSI_DISABLE();
+    }
+    if (!ret) {
+        return false;
+    }
+    // Oversampled results : sum of the samples, shifted to keep the required extra bits
+    uint32_t raw[ADCSCAN_MAX_CHANNELS+NB_INTERNAL_CHANS];
+    for(int i=0;i<nbConvs;i++) {
+        uint32_t sum = 0;
+        for(int s=0;s<OVERSAMPLE;s++) {
+            sum += _buf[i+(s*nbConvs)];
+        }
+        raw[i] = sum >> (OVERSAMPLE_LOG2-EXTRA_BITS);
+    }
+#if CALIBRATE
+    // VDDA from the VREFINT reading vs its factory value, then each channel in mV
+    if (raw[nbChans]==0) {
+        return false;
+    }
+    _vddaMV = (CAL_VDDA_MV * ((uint32_t)VREFINT_CAL << EXTRA_BITS)) / raw[nbChans];
+    for(int i=0;i<nbChans;i++) {
+        results[i] = (raw[i] * _vddaMV) / (ADC_FULLSCALE << EXTRA_BITS);
+    }
+#if MCU_TEMP
+    // temp sensor value as it would be at the calibration VDDA, then linear between the 2 calibration points
+    int32_t ts = (int32_t)((raw[nbChans+1] * _vddaMV) / CAL_VDDA_MV) >> EXTRA_BITS;
+    _mcuTemp = 300 + ((110-30)*10*(ts - (int32_t)TS_CAL1)) / ((int32_t)TS_CAL2 - (int32_t)TS_CAL1);
+#endif
+#else
+    for(int i=0;i<nbChans;i++) {
+        results[i] = raw[i];
+    }
+#endif
+    return true;
+}
+
+uint16_t adcscan_getVDDA() {
+    return _vddaMV;
+}
+int16_t adcscan_getMCUTemp() {
+    return _mcuTemp;
+}
+
+#else /* MYNEWT_VAL(MIO_ADC_SCAN) */
+
+// Scan not enabled for this target : mod_io uses the gpiomgr ADC read per channel
+int adcscan_gpioToChannel(int8_t gpio) {
+    return -1;
+}
+bool adcscan_read(const uint8_t* chans, int nbChans, uint16_t* results) {
+    return false;
+}
+uint16_t adcscan_getVDDA() {
+    return 0;
+}
+int16_t adcscan_getMCUTemp() {
+    return 0;
+}
+
+#endif /* MYNEWT_VAL(MIO_ADC_SCAN) */
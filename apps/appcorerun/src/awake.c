@@ -0,0 +1,178 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Awake time accounting : the time spent in each costly activity is accumulated, to get real data for the battery life of 
+ * each target. Counters are in RAM so kept during sleep, and reset on reboot.
+ */
+#include "os/os.h"
+
+#include "awake.h"
+
+#if MYNEWT_VAL(MIO_AWAKE_ACCOUNTING)
+
+static const char* _names[AWAKE_NB] = { "onewire", "adc", "usdist", "pwm", "log", "start" };
+static const uint32_t _currentsUA[AWAKE_NB] = { MYNEWT_VAL(MIO_AWAKE_CURRENTS_UA) };
+static struct {
+    uint64_t us;
+    uint32_t count;
+} _acc[AWAKE_NB];
+// Max tasks timing an activity at the same time (app-core task, default event queue, ...)
+#define AWAKE_TASKS (4)
+// returned by awake_enter() when no slot was free : the activity is counted but not timed
+#define AWAKE_UNTIMED ((AWAKE_SUBSYS)(AWAKE_NB+1))
+// per task, the innermost activity being timed, and since when its time is not accounted. Kept per task so that 
+// activities timed by different tasks (that can interleave when one blocks) don't get each other's time
+static struct {
+    struct os_task* task;       // NULL if slot free
+    AWAKE_SUBSYS current;
+    uint64_t since;
+} _timing[AWAKE_TASKS];
+
+uint64_t awake_now() {
+    return (uint64_t)os_get_uptime_usec();
+}
+
+void awake_add(AWAKE_SUBSYS s, uint32_t us) {
+    if (s<AWAKE_NB) {
+        os_sr_t sr;
+        OS_ENTER_CRITICAL(sr);
+        _acc[s].us += us;
+        _acc[s].count++;
+        OS_EXIT_CRITICAL(sr);
+    }
+}
+
+// slot of the current task, allocated if asked. -1 if none. Must be in critical section
+static int taskSlot(bool alloc) {
+    struct os_task* t = os_sched_get_current_task();
+    int free = -1;
+    for(int i=0;i<AWAKE_TASKS;i++) {
+        if (_timing[i].task==t) {
+            return i;
+        }
+        if (_timing[i].task==NULL && free<0) {
+            free = i;
+        }
+    }
+    if (alloc && free>=0) {
+        _timing[free].task = t;
+        _timing[free].current = AWAKE_NB;
+    }
+    return alloc ? free : -1;
+}
+
+// give the time since the last enter/leave of the task to the activity it is timing. Must be in critical section
+static void chargeCurrent(int slot) {
+    uint64_t now = awake_now();
+    if (_timing[slot].current<AWAKE_NB) {
+        _acc[_timing[slot].current].us += (now-_timing[slot].since);
+    }
+    _timing[slot].since = now;
+}
+
+AWAKE_SUBSYS awake_enter(AWAKE_SUBSYS s) {
+    if (s>=AWAKE_NB) {
+        return AWAKE_UNTIMED;
+    }
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    _acc[s].count++;
+    AWAKE_SUBSYS prev = AWAKE_UNTIMED;
+    int slot = taskSlot(true);
+    if (slot>=0) {
+        prev = _timing[slot].current;
+        chargeCurrent(slot);
+        _timing[slot].current = s;
+    }
+    OS_EXIT_CRITICAL(sr);
+    return prev;
+}
+
+void awake_leave(AWAKE_SUBSYS prev) {
+    if (prev==AWAKE_UNTIMED) {
+        return;
+    }
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    int slot = taskSlot(false);
+    if (slot>=0) {
+        chargeCurrent(slot);
+        _timing[slot].current = prev;
+        if (prev==AWAKE_NB) {
+            _timing[slot].task = NULL;      // outermost activity done
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+uint64_t awake_getUS(AWAKE_SUBSYS s) {
+    return (s<AWAKE_NB) ? _acc[s].us : 0;
+}
+uint32_t awake_getCount(AWAKE_SUBSYS s) {
+    return (s<AWAKE_NB) ? _acc[s].count : 0;
+}
+const char* awake_getName(AWAKE_SUBSYS s) {
+    return (s<AWAKE_NB) ? _names[s] : "?";
+}
+
+uint32_t awake_getChargeUAH() {
+    // uA.us -> uAh. Each us is in 1 activity at most, the rest of the time is sleep (not accounted here)
+    uint64_t c = 0;
+    for(int i=0;i<AWAKE_NB;i++) {
+        c += _acc[i].us * _currentsUA[i];
+    }
+    return (uint32_t)(c / (3600ULL*1000000ULL));
+}
+
+void awake_reset() {
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for(int i=0;i<AWAKE_NB;i++) {
+        _acc[i].us = 0;
+        _acc[i].count = 0;
+    }
+    uint64_t now = awake_now();
+    for(int i=0;i<AWAKE_TASKS;i++) {
+        _timing[i].since = now;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+#else /* MYNEWT_VAL(MIO_AWAKE_ACCOUNTING) */
+
+uint64_t awake_now() {
+    return 0;
+}
+void awake_add(AWAKE_SUBSYS s, uint32_t us) {
+}
+AWAKE_SUBSYS awake_enter(AWAKE_SUBSYS s) {
+    return AWAKE_NB;
+}
+void awake_leave(AWAKE_SUBSYS prev) {
+}
+uint64_t awake_getUS(AWAKE_SUBSYS s) {
+    return 0;
+}
+uint32_t awake_getCount(AWAKE_SUBSYS s) {
+    return 0;
+}
+const char* awake_getName(AWAKE_SUBSYS s) {
+    return "";
+}
+uint32_t awake_getChargeUAH() {
+    return 0;
+}
+void awake_reset() {
+}
+
+#endif /* MYNEWT_VAL(MIO_AWAKE_ACCOUNTING) */
@@ -0,0 +1,66 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Boot phase timing, to measure how long the device takes to be operational after a reset. Uses the cpu cycle counter as the 
+ * os time is not running before sysinit. The cycles of each phase are converted with the clock speed at its end, as the clock 
+ * may change during the boot.
+ */
+#include "os/os.h"
+
+#include "wyres-generic/wutils.h"
+
+#include "boottime.h"
+#include "cyccnt.h"
+#include "mio_log.h"
+
+#if MYNEWT_VAL(MIO_BOOT_TIMING)
+
+static struct {
+    const char* phase;
+    uint32_t us;            // since the first mark
+} _marks[BOOTTIME_MAX];
+static int _nbMarks = 0;
+static uint32_t _lastCyc = 0;
+static uint32_t _us = 0;
+
+void boottime_mark(const char* phase) {
+    if (_nbMarks==0) {
+        cyccnt_init();
+        _lastCyc = cyccnt_get();
+    }
+    if (_nbMarks>=BOOTTIME_MAX) {
+        return;
+    }
+    uint32_t now = cyccnt_get();
+    _us += (now - _lastCyc) / cyccnt_perUS();
+    _lastCyc = now;
+    _marks[_nbMarks].phase = phase;
+    _marks[_nbMarks].us = _us;
+    _nbMarks++;
+}
+
+void boottime_log() {
+    for(int i=0;i<_nbMarks;i++) {
+        MIO_LOG_INFO("BOOT:%s at %d ms (+%d)", _marks[i].phase, _marks[i].us/1000, 
+            (i>0)?((_marks[i].us - _marks[i-1].us)/1000):0);
+    }
+}
+
+#else /* MYNEWT_VAL(MIO_BOOT_TIMING) */
+
+void boottime_mark(const char* phase) {
+}
+void boottime_log() {
+}
+
+#endif /* MYNEWT_VAL(MIO_BOOT_TIMING) */
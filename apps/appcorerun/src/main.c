@@ -10,6 +10,8 @@
 #include "hal/hal_gpio.h"
 
 #include "build.h"
+#include "boottime.h"
+#include "mio_log.h"
 
 #include "wyres-generic/wutils.h"
 #include "wyres-generic/timemgr.h"
@@ -37,6 +39,8 @@ main(int argc, char **argv)
 #ifdef ARCH_sim
     mcu_sim_parse_args(argc, argv);
 #endif
+    boottime_mark("reset");
+#if !MYNEWT_VAL(MIO_FAST_BOOT)
     // Allow debugger to get its rear in gear (otherwise misses initial breakpoints) and signal booting
     hal_gpio_init_out(LED_1, 1);
     for (int i=0;i<5;i++) {
@@ -46,9 +50,12 @@ main(int argc, char **argv)
         hal_gpio_write(LED_1, 0);
     }
     hal_gpio_deinit(LED_1);
+    boottime_mark("blink");
+#endif
 
     // init everyone
     sysinit();
+    boottime_mark("sysinit");
 
     // unittest or real app?
 #ifdef UNITTEST
@@ -58,9 +65,11 @@ main(int argc, char **argv)
     ret &= unittest_cfg();
 //    assert(ret);        // If UTs fail, assert - this should probably return a value from the main?
 #endif /* UNITTEST */
-    log_info("%s v[%d.%d.%d] built[%s]", BUILD_TARGET_NAME, BUILD_VERSION_MAJOR, BUILD_VERSION_MINOR, BUILD_VERSION_DEVNUMBER, BUILD_DATE);
+    MIO_LOG_INFO("%s v[%d.%d.%d] built[%s]", BUILD_TARGET_NAME, BUILD_VERSION_MAJOR, BUILD_VERSION_MINOR, BUILD_VERSION_DEVNUMBER, BUILD_DATE);
     // startup app tasks etc
     app_core_start(BUILD_VERSION_MAJOR, BUILD_VERSION_MINOR, BUILD_VERSION_DEVNUMBER, BUILD_DATE, BUILD_TARGET_NAME);
+    boottime_mark("app start");
+    boottime_log();
 
     while (1) {
         os_eventq_run(os_eventq_dflt_get());
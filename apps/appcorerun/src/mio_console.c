@@ -0,0 +1,102 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * mod-io diagnostic commands for the mynewt shell. Needs the full console and the shell in the target instead of the stubs.
+ */
+#include <string.h>
+#include "os/os.h"
+
+#include "mio_console.h"
+#include "awake.h"
+#include "mioprof.h"
+#include "cyccnt.h"
+#include "mio_log.h"
+#include "mio_trace.h"
+#include "pinpark.h"
+
+#if MYNEWT_VAL(MIO_SHELL_CMDS)
+
+#include "console/console.h"
+#include "shell/shell.h"
+
+// awake time per activity : 'mio-awake' to show, 'mio-awake reset' to clear
+static int awakeCmd(int argc, char** argv) {
+    if (argc>1 && strcmp(argv[1], "reset")==0) {
+        awake_reset();
+        console_printf("awake counters reset\n");
+        return 0;
+    }
+    console_printf("%-8s %10s %8s\n", "activity", "ms", "count");
+    for(int i=0;i<AWAKE_NB;i++) {
+        console_printf("%-8s %10lu %8lu\n", awake_getName(i), (unsigned long)(awake_getUS(i)/1000), (unsigned long)awake_getCount(i));
+    }
+    console_printf("uptime %lu s, estimated charge %lu uAh\n", (unsigned long)(os_get_uptime_usec()/1000000), (unsigned long)awake_getChargeUAH());
+    return 0;
+}
+
+// cycle counts per profiled site (MIO_PROFILING) : 'mio-prof' to show, 'mio-prof reset' to clear
+static int profCmd(int argc, char** argv) {
+    if (argc>1 && strcmp(argv[1], "reset")==0) {
+        mioprof_reset();
+        console_printf("profiling reset\n");
+        return 0;
+    }
+    console_printf("%-12s %8s %10s %10s %10s %8s\n", "site", "count", "min", "max", "mean", "mean us");
+    for(int i=0;i<PROF_NB_SITES;i++) {
+        PROF_STATS_t st;
+        if (mioprof_getStats(i, &st)) {
+            console_printf("%-12s %8lu %10lu %10lu %10lu %8lu\n", mioprof_getName(i), (unsigned long)st.count, (unsigned long)st.min, 
+                (unsigned long)st.max, (unsigned long)st.mean, (unsigned long)(st.mean/cyccnt_perUS()));
+        }
+    }
+    return 0;
+}
+
+// write out the pending binary log records (MIO_BINARY_LOG) : 'mio-blog'
+static int blogCmd(int argc, char** argv) {
+    console_printf("%d records\n", mio_blog_drain());
+    return 0;
+}
+
+// write out the pending trace records (MIO_TRACE) : 'mio-trace'
+static int traceCmd(int argc, char** argv) {
+    console_printf("%d bytes\n", mio_trace_drain());
+    return 0;
+}
+
+// log the state of every pin and the likely leakage sources : 'mio-lp'
+static int lpCmd(int argc, char** argv) {
+    pinpark_report();
+    return 0;
+}
+
+static const struct shell_cmd _cmds[] = {
+    { .sc_cmd = "mio-awake", .sc_cmd_func = awakeCmd },
+    { .sc_cmd = "mio-prof", .sc_cmd_func = profCmd },
+    { .sc_cmd = "mio-blog", .sc_cmd_func = blogCmd },
+    { .sc_cmd = "mio-trace", .sc_cmd_func = traceCmd },
+    { .sc_cmd = "mio-lp", .sc_cmd_func = lpCmd },
+};
+
+void mio_console_init() {
+    for(int i=0;i<(int)(sizeof(_cmds)/sizeof(_cmds[0]));i++) {
+        shell_cmd_register(&_cmds[i]);
+    }
+}
+
+#else /* MYNEWT_VAL(MIO_SHELL_CMDS) */
+
+void mio_console_init() {
+}
+
+#endif /* MYNEWT_VAL(MIO_SHELL_CMDS) */
@@ -0,0 +1,171 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Deferred binary logging for the mod-io hot paths. Formatting a log line and sending it on the UART at 115200 takes ms of 
+ * awake time, so each call only stores the address of its format string and its raw args in a RAM ring (a few us). The ring is 
+ * written out as hex words from the default event queue (main task, lowest priority) every MIO_BLOG_DRAIN_SECS, or only when 
+ * asked with the 'mio-blog' shell command if 0, ie when a console is attached. tools/mio_blog.py expands the records using the elf.
+ * Record : format string address, (time ms<<8 | level<<4 | nargs), nargs x arg
+ * The record only has the low 24 bits of the time (4.6 hours), so a time record (format address 0, 1 arg : the full time in ms) 
+ * goes before the first record each time the upper bits change.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include "os/os.h"
+
+#include "wyres-generic/wutils.h"
+#include "wyres-generic/timemgr.h"
+
+#include "mio_log.h"
+#include "awake.h"
+
+#if MYNEWT_VAL(MIO_BINARY_LOG)
+
+#define BLOG_WORDS (MYNEWT_VAL(MIO_BLOG_BUF_SIZE)/4)
+// a line holds the longest record (10 args)
+#define BLOG_LINE_WORDS (12)
+
+static struct {
+    uint32_t ring[BLOG_WORDS];
+    uint32_t in;        // next word written
+    uint32_t out;       // next word to drain
+    uint32_t lost;
+    uint8_t timeHigh;   // upper 8 bits of the time of the last record
+    struct os_callout drainTimer;
+    struct os_event drainEv;
+} _blog;
+
+static void drainEvent(struct os_event* e);
+
+static uint32_t used() {
+    return (_blog.in+BLOG_WORDS-_blog.out)%BLOG_WORDS;
+}
+
+void mio_log_init() {
+    os_callout_init(&_blog.drainTimer, os_eventq_dflt_get(), drainEvent, NULL);
+    _blog.drainEv.ev_cb = drainEvent;
+    if (MYNEWT_VAL(MIO_BLOG_DRAIN_SECS)>0) {
+        os_callout_reset(&_blog.drainTimer, os_time_ms_to_ticks32(MYNEWT_VAL(MIO_BLOG_DRAIN_SECS)*1000));
+    }
+}
+
+// Can be called from an interrupt
+void mio_blog_push(uint8_t lvl, const char* fmt, int nargs, ...) {
+    va_list vl;
+    uint32_t n = 2+nargs;
+    os_sr_t sr;
+    bool drain = false;
+    OS_ENTER_CRITICAL(sr);
+    uint32_t now = TMMgr_getRelTimeMS();
+    bool newHigh = ((now>>24)!=_blog.timeHigh);
+    if (newHigh) {
+        n += 3;
+    }
+    // keep one word free to tell full from empty
+    if (used()+n>=BLOG_WORDS) {
+        _blog.lost++;
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+    if (newHigh) {
+        _blog.ring[_blog.in] = 0;
+        _blog.in = (_blog.in+1)%BLOG_WORDS;
+        _blog.ring[_blog.in] = (now<<8) | 1;
+        _blog.in = (_blog.in+1)%BLOG_WORDS;
+        _blog.ring[_blog.in] = now;
+        _blog.in = (_blog.in+1)%BLOG_WORDS;
+        _blog.timeHigh = (now>>24);
+    }
+    _blog.ring[_blog.in] = (uint32_t)(uintptr_t)fmt;
+    _blog.in = (_blog.in+1)%BLOG_WORDS;
+    _blog.ring[_blog.in] = (now<<8) | ((lvl & 0x3)<<4) | (nargs & 0xf);
+    _blog.in = (_blog.in+1)%BLOG_WORDS;
+    va_start(vl, nargs);
+    for(int i=0;i<nargs;i++) {
+        _blog.ring[_blog.in] = va_arg(vl, uint32_t);
+        _blog.in = (_blog.in+1)%BLOG_WORDS;
+    }
+    va_end(vl);
+    // drain early if 3/4 full, unless only draining on demand
+    drain = (MYNEWT_VAL(MIO_BLOG_DRAIN_SECS)>0 && used()>(BLOG_WORDS*3/4));
+    OS_EXIT_CRITICAL(sr);
+    if (drain && !_blog.drainEv.ev_queued) {
+        os_eventq_put(os_eventq_dflt_get(), &_blog.drainEv);
+    }
+}
+
+int mio_blog_drain() {
+    uint32_t words[BLOG_LINE_WORDS];
+    char line[BLOG_LINE_WORDS*8+1];
+    int nrecs = 0;
+    AWAKE_SUBSYS prev = awake_enter(AWAKE_LOG);
+    while(used()>0) {
+        // as many whole records as fit in a line, copied out so the formatting runs with interrupts on
+        int nw = 0;
+        os_sr_t sr;
+        OS_ENTER_CRITICAL(sr);
+        while(used()>0) {
+            uint32_t rn = 2+(_blog.ring[(_blog.out+1)%BLOG_WORDS] & 0xf);
+            if (nw>0 && nw+rn>BLOG_LINE_WORDS) {
+                break;
+            }
+            for(int i=0;i<rn;i++) {
+                words[nw++] = _blog.ring[_blog.out];
+                _blog.out = (_blog.out+1)%BLOG_WORDS;
+            }
+            nrecs++;
+        }
+        OS_EXIT_CRITICAL(sr);
+        for(int i=0;i<nw;i++) {
+            sprintf(&line[i*8], "%08lx", (unsigned long)words[i]);
+        }
+        line[nw*8] = '\0';
+        log_info("BL:%s", line);
+    }
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    uint32_t lost = _blog.lost;
+    _blog.lost = 0;
+    OS_EXIT_CRITICAL(sr);
+    if (lost>0) {
+        log_warn("BL:lost %d", lost);
+    }
+    awake_leave(prev);
+    return nrecs;
+}
+
+uint32_t mio_blog_getLost() {
+    return _blog.lost;
+}
+
+static void drainEvent(struct os_event* e) {
+    mio_blog_drain();
+    if (MYNEWT_VAL(MIO_BLOG_DRAIN_SECS)>0) {
+        os_callout_reset(&_blog.drainTimer, os_time_ms_to_ticks32(MYNEWT_VAL(MIO_BLOG_DRAIN_SECS)*1000));
+    }
+}
+
+#else /* MYNEWT_VAL(MIO_BINARY_LOG) */
+
+void mio_log_init() {
+}
+void mio_blog_push(uint8_t lvl, const char* fmt, int nargs, ...) {
+}
+int mio_blog_drain() {
+    return 0;
+}
+uint32_t mio_blog_getLost() {
+    return 0;
+}
+
+#endif /* MYNEWT_VAL(MIO_BINARY_LOG) */
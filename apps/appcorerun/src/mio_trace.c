@@ -0,0 +1,215 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Field trace of the mod-io events : the input callbacks, the values read from the ios, the DL actions and the UL data, each 
+ * with its time, so that a field behaviour (burst presses, sensor dropouts, DL storms) can be replayed in the sim. The records 
+ * are a few bytes (varint time delta, zigzag varint values) in a RAM ring, written out as 'TR:' hex lines from the default event 
+ * queue every MIO_TRACE_DRAIN_SECS (or only with the 'mio-trace' shell command if 0). The hex is a byte stream : a record can 
+ * span 2 lines. When the ring is full new records are dropped and counted ('TR:lost n').
+ * Record : (type<<4 | io id), time since the previous record in ms (varint, since boot for TR_START), then per type
+ *   TR_BUTTON, TR_STATE : (press type<<4 | state)
+ *   TR_SAMPLE : value (zigzag varint), TR_NOSAMPLE : none
+ *   TR_DL : action id, length, bytes
+ *   TR_UL : size, number of bytes kept, the bytes (mod-io TLVs)
+ */
+#include <stdio.h>
+#include <string.h>
+#include "os/os.h"
+
+#include "wyres-generic/wutils.h"
+#include "wyres-generic/timemgr.h"
+
+#include "mio_trace.h"
+#include "awake.h"
+
+#if MYNEWT_VAL(MIO_TRACE)
+
+#define TRACE_SZ (MYNEWT_VAL(MIO_TRACE_BUF_SIZE))
+#define TRACE_LINE_BYTES (32)
+// biggest data (a DL or a UL, with its 2 bytes before), and record with the header and the time
+#define TRACE_MAX_DATA (2+MYNEWT_VAL(MIO_TRACE_UL_MAX))
+#define TRACE_MAX_REC (1+5+TRACE_MAX_DATA)
+
+static struct {
+    uint8_t ring[TRACE_SZ];
+    uint32_t in;        // next byte written
+    uint32_t out;       // next byte to drain
+    uint32_t lastMS;    // time of the last record stored
+    uint32_t lost;
+    uint8_t ul[TRACE_MAX_DATA];     // UL being built : size, bytes kept, the bytes
+    struct os_callout drainTimer;
+    struct os_event drainEv;
+} _trace;
+
+static void drainEvent(struct os_event* e);
+static void record(MIO_TRACE_TYPE_t type, int ioid, uint8_t* d, int l);
+
+static uint32_t used() {
+    return (_trace.in+TRACE_SZ-_trace.out)%TRACE_SZ;
+}
+
+static int putVarint(uint8_t* b, uint32_t v) {
+    int n = 0;
+    while(v>=0x80) {
+        b[n++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    b[n++] = v;
+    return n;
+}
+
+void mio_trace_init() {
+    os_callout_init(&_trace.drainTimer, os_eventq_dflt_get(), drainEvent, NULL);
+    _trace.drainEv.ev_cb = drainEvent;
+    if (MYNEWT_VAL(MIO_TRACE_DRAIN_SECS)>0) {
+        os_callout_reset(&_trace.drainTimer, os_time_ms_to_ticks32(MYNEWT_VAL(MIO_TRACE_DRAIN_SECS)*1000));
+    }
+    // time since boot of the first record, the others are relative to it
+    _trace.lastMS = 0;
+    record(TR_START, 0, NULL, 0);
+}
+
+// Can be called from an interrupt
+static void record(MIO_TRACE_TYPE_t type, int ioid, uint8_t* d, int l) {
+    uint8_t rec[TRACE_MAX_REC];
+    os_sr_t sr;
+    bool drain = false;
+    OS_ENTER_CRITICAL(sr);
+    uint32_t now = TMMgr_getRelTimeMS();
+    int n = 0;
+    rec[n++] = (type<<4) | (ioid & 0x0F);
+    n += putVarint(&rec[n], now-_trace.lastMS);
+    for(int i=0;i<l;i++) {
+        rec[n++] = d[i];
+    }
+    // keep one byte free to tell full from empty
+    if (used()+n>=TRACE_SZ) {
+        _trace.lost++;
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+    for(int i=0;i<n;i++) {
+        _trace.ring[_trace.in] = rec[i];
+        _trace.in = (_trace.in+1)%TRACE_SZ;
+    }
+    _trace.lastMS = now;
+    // drain early if 3/4 full, unless only draining on demand
+    drain = (MYNEWT_VAL(MIO_TRACE_DRAIN_SECS)>0 && used()>(TRACE_SZ*3/4));
+    OS_EXIT_CRITICAL(sr);
+    if (drain && !_trace.drainEv.ev_queued) {
+        os_eventq_put(os_eventq_dflt_get(), &_trace.drainEv);
+    }
+}
+
+void mio_trace_input(MIO_TRACE_TYPE_t type, int ioid, uint8_t state, uint8_t pressType) {
+    uint8_t d = (pressType<<4) | (state & 0x0F);
+    record(type, ioid, &d, 1);
+}
+
+void mio_trace_sample(int ioid, int32_t value, bool valid) {
+    uint8_t d[5];
+    if (valid) {
+        // zigzag : small negative values stay short (shifted as unsigned, a left shift of a negative int is undefined)
+        record(TR_SAMPLE, ioid, d, putVarint(d, ((uint32_t)value << 1) ^ (uint32_t)-(value < 0)));
+    } else {
+        record(TR_NOSAMPLE, ioid, d, 0);
+    }
+}
+
+void mio_trace_dl(uint8_t action, uint8_t* v, uint8_t l) {
+    uint8_t d[TRACE_MAX_DATA];
+    if (l>MYNEWT_VAL(MIO_TRACE_UL_MAX)) {
+        l = MYNEWT_VAL(MIO_TRACE_UL_MAX);
+    }
+    d[0] = action;
+    d[1] = l;
+    memcpy(&d[2], v, l);
+    record(TR_DL, 0, d, 2+l);
+}
+
+void mio_trace_ulTLV(uint8_t t, uint8_t l, void* v) {
+    uint8_t tl[2] = { t, l };
+    for(int i=0;i<2+l;i++) {
+        if (_trace.ul[1]<MYNEWT_VAL(MIO_TRACE_UL_MAX)) {
+            _trace.ul[2+_trace.ul[1]++] = (i<2)?tl[i]:((uint8_t*)v)[i-2];
+        }
+    }
+    _trace.ul[0] += 2+l;
+}
+
+void mio_trace_ulEnd() {
+    record(TR_UL, 0, _trace.ul, 2+_trace.ul[1]);
+    _trace.ul[0] = 0;
+    _trace.ul[1] = 0;
+}
+
+int mio_trace_drain() {
+    uint8_t bytes[TRACE_LINE_BYTES];
+    char line[TRACE_LINE_BYTES*2+1];
+    int nb = 0;
+    AWAKE_SUBSYS prev = awake_enter(AWAKE_LOG);
+    while(used()>0) {
+        // copied out so the formatting runs with interrupts on
+        int n = 0;
+        os_sr_t sr;
+        OS_ENTER_CRITICAL(sr);
+        while(used()>0 && n<TRACE_LINE_BYTES) {
+            bytes[n++] = _trace.ring[_trace.out];
+            _trace.out = (_trace.out+1)%TRACE_SZ;
+        }
+        OS_EXIT_CRITICAL(sr);
+        for(int i=0;i<n;i++) {
+            sprintf(&line[i*2], "%02x", bytes[i]);
+        }
+        line[n*2] = '\0';
+        nb += n;
+        log_info("TR:%s", line);
+    }
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    uint32_t lost = _trace.lost;
+    _trace.lost = 0;
+    OS_EXIT_CRITICAL(sr);
+    if (lost>0) {
+        log_warn("TR:lost %d", lost);
+    }
+    awake_leave(prev);
+    return nb;
+}
+
+static void drainEvent(struct os_event* e) {
+    mio_trace_drain();
+    if (MYNEWT_VAL(MIO_TRACE_DRAIN_SECS)>0) {
+        os_callout_reset(&_trace.drainTimer, os_time_ms_to_ticks32(MYNEWT_VAL(MIO_TRACE_DRAIN_SECS)*1000));
+    }
+}
+
+#else /* MYNEWT_VAL(MIO_TRACE) */
+
+void mio_trace_init() {
+}
+void mio_trace_input(MIO_TRACE_TYPE_t type, int ioid, uint8_t state, uint8_t pressType) {
+}
+void mio_trace_sample(int ioid, int32_t value, bool valid) {
+}
+void mio_trace_dl(uint8_t action, uint8_t* v, uint8_t l) {
+}
+void mio_trace_ulTLV(uint8_t t, uint8_t l, void* v) {
+}
+void mio_trace_ulEnd() {
+}
+int mio_trace_drain() {
+    return 0;
+}
+
+#endif /* MYNEWT_VAL(MIO_TRACE) */
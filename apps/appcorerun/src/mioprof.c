@@ -0,0 +1,98 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Cycle count profiling of the mod-io hot paths, to measure the cost of each io type on the real MCU and catch regressions.
+ * The cycles are counted by the DWT, so only while the cpu runs : time sleeping in a site (eg waiting on a semaphore) is not counted.
+ */
+#include "os/os.h"
+
+#include "mioprof.h"
+
+#if MYNEWT_VAL(MIO_PROFILING)
+
+#include "cyccnt.h"
+
+static const char* _names[PROF_NB_SITES] = { "readIOs", "getData", "iosetAction", "buttonCB", "stateCB", 
+        "readDIN", "readAIN", "readDS18B20", "readCOUNTER", "readFREQ", "readUSDIST" };
+static struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} _sites[PROF_NB_SITES];
+
+void mioprof_init() {
+    cyccnt_init();
+    mioprof_reset();
+}
+
+void mioprof_record(PROF_SITE site, uint32_t cycles) {
+    if (site>=PROF_NB_SITES) {
+        return;
+    }
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if (cycles<_sites[site].min) {
+        _sites[site].min = cycles;
+    }
+    if (cycles>_sites[site].max) {
+        _sites[site].max = cycles;
+    }
+    _sites[site].sum += cycles;
+    _sites[site].count++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+bool mioprof_getStats(PROF_SITE site, PROF_STATS_t* stats) {
+    if (site>=PROF_NB_SITES || _sites[site].count==0) {
+        return false;
+    }
+    stats->count = _sites[site].count;
+    stats->min = _sites[site].min;
+    stats->max = _sites[site].max;
+    stats->mean = (uint32_t)(_sites[site].sum / _sites[site].count);
+    return true;
+}
+
+const char* mioprof_getName(PROF_SITE site) {
+    return (site<PROF_NB_SITES) ? _names[site] : "?";
+}
+
+void mioprof_reset() {
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for(int i=0;i<PROF_NB_SITES;i++) {
+        _sites[i].count = 0;
+        _sites[i].min = UINT32_MAX;
+        _sites[i].max = 0;
+        _sites[i].sum = 0;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+#else /* MYNEWT_VAL(MIO_PROFILING) */
+
+void mioprof_init() {
+}
+void mioprof_record(PROF_SITE site, uint32_t cycles) {
+}
+bool mioprof_getStats(PROF_SITE site, PROF_STATS_t* stats) {
+    return false;
+}
+const char* mioprof_getName(PROF_SITE site) {
+    return "";
+}
+void mioprof_reset() {
+}
+
+#endif /* MYNEWT_VAL(MIO_PROFILING) */
@@ -31,20 +31,73 @@
 
 #include "onewire.h"
 #include "DS18B20.h"
+#include "adcscan.h"
+#include "pulsein.h"
+#include "usdist.h"
+#include "pinpark.h"
+#include "awake.h"
+#include "mio_console.h"
+#include "mioprof.h"
+#include "mio_log.h"
+#include "mio_trace.h"
 
 // Use the PTI module id, as won't have both at same time
 #define MY_MOD_ID   (APP_MOD_PTI)
 
 // IO setup types. Note IO_OUTPUT_TYPE : all input types should be before this guy, all output types after
-typedef enum { IO_DIN=0, IO_BUTTON, IO_BUTTON_LINKED, IO_STATE, IO_AIN, IO_DS18B20, IO_USDIST_TRIG, IO_USDIST_INTR, 
-                IO_OUTPUT_TYPE, IO_PWMOUT, IO_DOUT } IO_TYPE;
+typedef enum { IO_DIN=0, IO_BUTTON, IO_BUTTON_LINKED, IO_STATE, IO_AIN, IO_DS18B20, IO_USDIST_TRIG, IO_USDIST_INTR, IO_COUNTER, IO_FREQ,
+                IO_OUTPUT_TYPE, IO_PWMOUT, IO_DOUT, IO_SENSOR_PWR } IO_TYPE;
 
 // Number of managed IOs related to the syscfg defines being 0-7 : don't change it...
 #define NB_IOS  (8)
 
 // define our specific ul tags that only our app needs to decode
 #define UL_APP_IO_STATE (APP_CORE_UL_APP_SPECIFIC_START)
+#define UL_APP_IO_FORCEDUL_STATS (APP_CORE_UL_APP_SPECIFIC_START+1)
+#define UL_APP_IO_EVENTS (APP_CORE_UL_APP_SPECIFIC_START+2)
+#define UL_APP_IO_MEASURES (APP_CORE_UL_APP_SPECIFIC_START+3)
+#define UL_APP_IO_COUNTERS (APP_CORE_UL_APP_SPECIFIC_START+4)
+#define UL_APP_IO_AWAKE (APP_CORE_UL_APP_SPECIFIC_START+5)
 #define DL_APP_IO_SET (APP_CORE_DL_APP_SPECIFIC_START)
+#define DL_APP_IO_SETMASK (APP_CORE_DL_APP_SPECIFIC_START+1)
+#define DL_APP_IO_TIMED (APP_CORE_DL_APP_SPECIFIC_START+2)
+
+#define DL_APP_IO_RULE (APP_CORE_DL_APP_SPECIFIC_START+3)
+#define DL_APP_IO_AWAKE (APP_CORE_DL_APP_SPECIFIC_START+4)
+
+// Timed output modes for DL_APP_IO_TIMED
+typedef enum { TIMED_SET_FOR_SECS=0, TIMED_PULSE_MS, TIMED_SET_AFTER_SECS } TIMED_MODE;
+
+// Local rules linking an input to an output : condition on the input value, and action on the output when it becomes true
+#define NB_RULES (MYNEWT_VAL(MIO_NB_RULES))
+typedef enum { RULE_NONE=0, RULE_GT, RULE_LT, RULE_EQ, RULE_CHANGE } RULE_COND;
+typedef enum { RULE_ACT_SET=0, RULE_ACT_TOGGLE, RULE_ACT_PULSE } RULE_ACTION;
+
+// Forced UL coalescing window and token bucket rate limiting (see syscfg)
+#define FORCEUL_COALESCE_MS (MYNEWT_VAL(MIO_FORCEUL_COALESCE_MS))
+#define FORCEUL_BUCKET_SIZE (MYNEWT_VAL(MIO_FORCEUL_BUCKET_SIZE))
+#define FORCEUL_REFILL_MS   (MYNEWT_VAL(MIO_FORCEUL_REFILL_SECS)*1000)
+// the tokens are counted in a uint8_t
+#if FORCEUL_BUCKET_SIZE<0 || FORCEUL_BUCKET_SIZE>255
+#error "MIO_FORCEUL_BUCKET_SIZE must be 0 to 255"
+#endif
+
+// Input event history between ULs (see syscfg)
+#define EVENT_BUF_SIZE (MYNEWT_VAL(MIO_EVENT_BUF_SIZE))
+#define EVENT_UL_MAX (MYNEWT_VAL(MIO_EVENT_UL_MAX))
+
+// DS18B20 io giving the air temperature for the ultrasonic distance, and temperature to use if none (1/16 degC)
+#define USDIST_TEMP_IO (MYNEWT_VAL(MIO_USDIST_TEMP_IO))
+#define USDIST_DEFAULT_TEMP16 (20*16)
+
+// Time each io type needs between start and a valid read (ms), 0 if it reads immediately. IO_FREQ uses its gate time, 
+// IO_SENSOR_PWR its settle time
+static const uint32_t _typeWarmupMS[IO_SENSOR_PWR+1] = {
+    [IO_DS18B20] = MYNEWT_VAL(MIO_DS18B20_CONV_MS),
+    [IO_USDIST_TRIG] = MYNEWT_VAL(MIO_USDIST_MAX_MS),
+};
+// Period for checking if warming up sensors are ready before their warmup time
+#define WARMUP_POLL_MS (MYNEWT_VAL(MIO_WARMUP_POLL_MS))
 
 // COntext data
 static struct appctx {
@@ -55,44 +108,170 @@ static struct appctx {
         GPIO_IDLE_TYPE pull;
         uint8_t valueDL;
         uint8_t valueUL;
-        int linkedDOUTioid;
+        int32_t measure;            // last input value at full resolution (raw adc, 1/16 degC, press type..)
+        bool measureValid;          // false if the last read of a sensor failed
+        struct os_callout timer;    // for timed outputs
+        uint8_t timedValue;         // value to write when timer expires
+        // sampling between ULs and aggregation of the samples for the next UL
+        uint32_t samplePeriodMS;    // 0 if only read at UL time
+        struct os_callout sampleTimer;
+        int32_t aggMin;
+        int32_t aggMax;
+        int64_t aggSum;
+        int32_t aggLast;            // last valid sample, as measure can hold a failed read
+        uint16_t aggCount;
+        // AIN scaling from mV to engineering unit (calibrated scan only) : value = (mV*scaleMul)/scaleDiv + scaleOffset
+        int16_t scaleMul;
+        int16_t scaleDiv;
+        int16_t scaleOffset;
+        // IO_COUNTER : total at last read, and at last UL for the delta
+        uint32_t count;
+        uint32_t countAtUL;
+        // time needed between start and read, and true while started and not yet ready
+        uint32_t warmupMS;
+        bool warming;
+        bool acquired;              // read during the start phase, getData uses it as is
+        bool sampleStarted;         // sample timer is waiting for the warmup before reading
+        uint32_t echoUS;            // IO_USDIST_TRIG : echo time of the last burst, converted when read (after the temperature)
+        int8_t pwrIO;               // IO_SENSOR_PWR io powering this sensor, -1 if none
     } ios[NB_IOS];
+    struct miorule {
+        int8_t srcIO;               // -1 if rule not used
+        uint8_t cond;               // RULE_COND
+        int16_t threshold;          // compared to the src io measure
+        int8_t dstIO;
+        uint8_t action;             // RULE_ACTION
+        uint16_t param;             // value for RULE_ACT_SET, duration in ms for RULE_ACT_PULSE
+        bool condTrue;              // condition state at last evaluation, action is only done when it becomes true
+        bool primed;                // lastValue is valid
+        int32_t lastValue;          // for RULE_CHANGE
+    } rules[NB_RULES];
+    // forced UL request handling
+    struct os_callout forceULTimer;
+    bool forceULPending;
+    uint8_t forceULTokens;
+    uint32_t lastRefillTS;
+    // counters since last UL : input events merged into an already requested UL, forced ULs sent, forced ULs refused by rate limit
+    uint16_t nbEventsMerged;
+    uint16_t nbForcedULs;
+    uint16_t nbForcedULsLimited;
+    bool ainScanned;            // AIN measures are fresh from a scan for this read of all ios
+    bool probed;                // sensors checked after boot
+    bool lpReported;            // pin states logged at the first sleep (MIO_LP_REPORT)
+    uint16_t nbULsSinceAwake;   // ULs since the last awake time TLV
+    bool awakeULPending;        // awake time TLV due (period or DL request), until there is room for it in a UL
+    uint8_t ulBytes;            // size of the TLVs already in the UL being built
+    struct os_callout warmupTimer;  // polls the warming sensors to end the start phase early
+    struct os_callout pwrTimer;     // end of the sensor power settle time
+#if EVENT_BUF_SIZE>0
+    // ring of input events since last UL, oldest overwritten when full
+    struct mioevent {
+        uint32_t ts;        // rel time in ms
+        uint8_t ioid;
+        uint8_t value;
+    } events[EVENT_BUF_SIZE];
+    uint8_t evFirst;
+    uint8_t evCount;
+    uint16_t nbEventsLost;
+#endif
 } _ctx;
 
 static void defineIO(int ioid, int gpio, const char* name, IO_TYPE t, GPIO_IDLE_TYPE pull, uint8_t initialValue);
+static void defineRule(int srcIO, RULE_COND cond, int16_t threshold, int dstIO, RULE_ACTION action, uint16_t param);
+static void defineSampling(int ioid, uint32_t periodSecs);
+static void defineAINScale(int ioid, int16_t mul, int16_t div, int16_t offset);
+static void defineSensorPower(int pwrIO, int ioid);
+static void parkPin(int gpio);
+static uint32_t sensorPower(bool on);
+static void sensorPowerSettled(struct os_event* e);
 static void initIOs();
+static void probeIOs();
 static void deinitIOs();
-static void startIOs();
+static uint32_t startIOs();
 static void readIOs();
 static uint8_t readIO(int ioid);
 static void writeIO(int ioid);
 static void iosetAction(uint8_t* v, uint8_t l);
+static void iosetmaskAction(uint8_t* v, uint8_t l);
+static void iotimedAction(uint8_t* v, uint8_t l);
+static void timedIOExpiry(struct os_event* e);
+static bool startTimedIO(int ioid, uint8_t mode, uint8_t val, uint32_t t);
+static void ioruleAction(uint8_t* v, uint8_t l);
+static void evaluateRules(int ioid, bool isEvent);
 static void buttonChangeCB(void* ctx, SR_BUTTON_STATE_t currentState, SR_BUTTON_PRESS_TYPE_t currentPressType);
 static void stateInputChangeCB(void* ctx, SR_BUTTON_STATE_t currentState, SR_BUTTON_PRESS_TYPE_t currentPressType);
 static bool isOut(IO_TYPE t);
+static void requestForcedUL();
+static void forceULTimeout(struct os_event* e);
+static void recordEvent(int ioid, uint8_t value);
+static void addEventsUL(APP_CORE_UL_t* ul);
+static bool hasMeasure(IO_TYPE t);
+static void addSample(int ioid);
+static void addMeasuresUL(APP_CORE_UL_t* ul);
+static void sampleTimeout(struct os_event* e);
+#if MYNEWT_VAL(MIO_ADC_SCAN)
+static void scanAINs();
+#endif
+static void addCountersUL(APP_CORE_UL_t* ul);
+static void addAwakeUL(APP_CORE_UL_t* ul);
+#if MYNEWT_VAL(MIO_AWAKE_ACCOUNTING)
+static void ioawakeAction(uint8_t* v, uint8_t l);
+#endif
+static hal_gpio_pull_t halPull(GPIO_IDLE_TYPE p);
+static int findIO(IO_TYPE t);
+static bool addTLV(APP_CORE_UL_t* ul, uint8_t t, uint8_t l, void* v);
+static bool fitsUL(uint8_t l);
+static void warmupCheck(struct os_event* e);
+static void collectIO(int ioid);
+static void ioReady(int ioid);
+static void freqDone(int ioid);
+static void usdistDone(void* ctx, uint32_t echoUS);
 
 // My api functions
+static uint32_t doStart() {
+    // ADC back as it was before sleeping
+    pinpark_restoreAll();
+    if (!_ctx.probed) {
+        MIO_LOG_INFO("MIO:first start %d ms after boot", TMMgr_getRelTimeMS());
+        probeIOs();
+    }
+    // only as long as the slowest sensor we started needs
+    uint32_t warmupMS = startIOs();
+    MIO_LOG_DEBUG("MIO:start:%dms", warmupMS);
+    return warmupMS;
+}
 static uint32_t start() {
-    log_debug("MIO:start:1s");
-    startIOs();
-    return 1*1000;
+    // only the cpu time of the start : the device sleeps during the warmup, and the sensor accesses are their own activities
+    uint32_t warmupMS;
+    AWAKE_TIMED(AWAKE_START, warmupMS = doStart());
+    return warmupMS;
 }
 
 static void stop() {
-    log_debug("MIO:done");
+    // sensors not ready in time were read by getData
+    os_callout_stop(&_ctx.warmupTimer);
+    for(int i=0;i<NB_IOS;i++) {
+        _ctx.ios[i].warming = false;
+    }
+    MIO_LOG_DEBUG("MIO:done");
 }
 static void off() {
     // ensure sensors are low power mode
+    sensorPower(false);
     deinitIOs();
 }
 static void deepsleep() {
     // ensure sensors are off
+    sensorPower(false);
     deinitIOs();
 }
 static bool getData(APP_CORE_UL_t* ul) {
-    log_info("MIO: UL ");
+    PROF_START(t);
+    MIO_LOG_INFO("MIO: UL ");
     // Read values
     readIOs();
+    // and no need to power the sensors any more
+    sensorPower(false);
     // write to UL TS and current states
     /* structure equiv:
      * uint8_t[8] io analog read 1 byte per IO. 0 if its an output
@@ -100,13 +279,44 @@ static bool getData(APP_CORE_UL_t* ul) {
      */
     uint8_t ds[NB_IOS+1];
     for(int i=0;i<NB_IOS;i++) {
-        log_info("I%d[%s][%d]:%d:%d", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].type, isOut(_ctx.ios[i].type)?_ctx.ios[i].valueDL:_ctx.ios[i].valueUL);
+        AWAKE_TIMED(AWAKE_LOG, MIO_LOG_INFO("I%d[%s][%d]:%d:%d", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].type, isOut(_ctx.ios[i].type)?_ctx.ios[i].valueDL:_ctx.ios[i].valueUL));
         // send up value : UL value for input types, DL value for output types
         ds[i] = isOut(_ctx.ios[i].type)?_ctx.ios[i].valueDL:_ctx.ios[i].valueUL;
         _ctx.ios[i].valueUL = 0;      // reset value to ensure we get latest button press types
     }
     ds[NB_IOS] = (AppCore_isDeviceActive()?1:0);
-    app_core_msg_ul_addTLV(ul, UL_APP_IO_STATE, 12, &ds[0]);
+    _ctx.ulBytes = 0;
+    addTLV(ul, UL_APP_IO_STATE, 12, &ds[0]);
+    // This UL carries any input change waiting for the coalescing window, so no need to force another one
+    if (_ctx.forceULPending) {
+        os_callout_stop(&_ctx.forceULTimer);
+        _ctx.forceULPending = false;
+        _ctx.nbEventsMerged++;
+    }
+    // Forced UL counters only sent if something happened since last UL
+    if (_ctx.nbEventsMerged>0 || _ctx.nbForcedULs>0 || _ctx.nbForcedULsLimited>0) {
+        MIO_LOG_INFO("MIO: forced UL stats merged:%d sent:%d limited:%d", _ctx.nbEventsMerged, _ctx.nbForcedULs, _ctx.nbForcedULsLimited);
+        uint8_t fs[6];
+        fs[0] = _ctx.nbEventsMerged & 0xFF;
+        fs[1] = (_ctx.nbEventsMerged >> 8) & 0xFF;
+        fs[2] = _ctx.nbForcedULs & 0xFF;
+        fs[3] = (_ctx.nbForcedULs >> 8) & 0xFF;
+        fs[4] = _ctx.nbForcedULsLimited & 0xFF;
+        fs[5] = (_ctx.nbForcedULsLimited >> 8) & 0xFF;
+        // if it didn't fit, the counts go on adding up for the next UL
+        if (addTLV(ul, UL_APP_IO_FORCEDUL_STATS, sizeof(fs), &fs[0])) {
+            _ctx.nbEventsMerged = 0;
+            _ctx.nbForcedULs = 0;
+            _ctx.nbForcedULsLimited = 0;
+        }
+    }
+    addEventsUL(ul);
+    // a due awake time TLV goes first, as the measures and counters can wait for the next UL without loss
+    addAwakeUL(ul);
+    addMeasuresUL(ul);
+    addCountersUL(ul);
+    mio_trace_ulEnd();
+    PROF_END(PROF_GETDATA, t);
     return true;       // all critical!
 }
 static void tick() {
@@ -125,6 +335,13 @@ static APP_CORE_API_t _api = {
 void mod_io_init(void) {
     for(int i=0;i<NB_IOS;i++) {
         _ctx.ios[i].gpio = -1;       // ensure disabled by default
+        _ctx.ios[i].scaleMul = 1;    // AINs in mV by default
+        _ctx.ios[i].scaleDiv = 1;
+        _ctx.ios[i].pwrIO = -1;
+    }
+    // rules before ios as linked buttons create one
+    for(int r=0;r<NB_RULES;r++) {
+        _ctx.rules[r].srcIO = -1;
     }
     MYNEWT_VAL(IO_0);
     MYNEWT_VAL(IO_1);
@@ -134,41 +351,73 @@ void mod_io_init(void) {
     MYNEWT_VAL(IO_5);
     MYNEWT_VAL(IO_6);
     MYNEWT_VAL(IO_7);
+    for(int i=0;i<NB_IOS;i++) {
+        // context for timed outputs is the io id
+        os_callout_init(&_ctx.ios[i].timer, os_eventq_dflt_get(), timedIOExpiry, (void*)i);
+        os_callout_init(&_ctx.ios[i].sampleTimer, os_eventq_dflt_get(), sampleTimeout, (void*)i);
+    }
+    MYNEWT_VAL(MIO_RULES);
+    MYNEWT_VAL(MIO_SAMPLING);
+    MYNEWT_VAL(MIO_AIN_SCALING);
+    MYNEWT_VAL(MIO_SENSOR_POWER);
+    MYNEWT_VAL(MIO_PARK_PINS);
+    // forced UL bucket starts full
+    os_callout_init(&_ctx.forceULTimer, os_eventq_dflt_get(), forceULTimeout, NULL);
+    os_callout_init(&_ctx.warmupTimer, os_eventq_dflt_get(), warmupCheck, NULL);
+    os_callout_init(&_ctx.pwrTimer, os_eventq_dflt_get(), sensorPowerSettled, NULL);
+    _ctx.forceULPending = false;
+    _ctx.forceULTokens = FORCEUL_BUCKET_SIZE;
+    _ctx.lastRefillTS = TMMgr_getRelTimeMS();
     // hook app-core for env data
     AppCore_registerModule("IO", MY_MOD_ID, &_api, EXEC_PARALLEL);
     AppCore_registerAction(DL_APP_IO_SET, iosetAction);
+    AppCore_registerAction(DL_APP_IO_SETMASK, iosetmaskAction);
+    AppCore_registerAction(DL_APP_IO_TIMED, iotimedAction);
+    AppCore_registerAction(DL_APP_IO_RULE, ioruleAction);
+#if MYNEWT_VAL(MIO_AWAKE_ACCOUNTING)
+    AppCore_registerAction(DL_APP_IO_AWAKE, ioawakeAction);
+#endif
+    mioprof_init();
+    mio_log_init();
+    mio_trace_init();
+    mio_console_init();
     initIOs();
-    log_info("MIO: io operation initialised");
-
-}
+#if !MYNEWT_VAL(MIO_FAST_BOOT)
+    probeIOs();
+#endif
+    // and start sampling ios that need it
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].samplePeriodMS>0) {
+            os_callout_reset(&_ctx.ios[i].sampleTimer, os_time_ms_to_ticks32(_ctx.ios[i].samplePeriodMS));
+        }
+    }
+    MIO_LOG_INFO("MIO: io operation initialised");
 
-// TODO implement
-static uint32_t usdist_read(int8_t trig, int8_t intr) {
-    return 0;
 }
 
-static uint32_t ds18B20_read(int8_t pin) {
-    uint32_t ret = 0;
-    log_info("try to read DS18B20 on pin %d", pin);
+// Read temperature in 1/16 degC, false if no valid reading
+static bool ds18B20_read(int8_t pin, int32_t* temp) {
+    MIO_LOG_INFO("try to read DS18B20 on pin %d", pin);
     // Simplistic case of single sensor on wire : read first address and read its temp
     unsigned char addr[8];
     addr[0]=0xBA;
     addr[1]=0xD0;
     if (ds18B20_getSingleAddress(pin, addr)) {
         // note first byte of address tells you device type : 0x28 = DS18B20
-        log_info("device responded, got an address starting %02x %02x", addr[0], addr[1]);
-        ret = ds18B20_getTemperatureInt(pin, addr);
-        log_info("got temp %d", ret);
-        return ret;
+        MIO_LOG_INFO("device responded, got an address starting %02x %02x", addr[0], addr[1]);
+        *temp = ds18B20_getTemperatureInt(pin, addr);
+        MIO_LOG_INFO("got temp %d", *temp);
+        return true;
     } else {
         // if the addr values were overwritten, then bad crc, else didn't init so no device present
         if (addr[0]==0xBA) {
-            log_warn("no device responds on onewire bus");
+            MIO_LOG_WARN("no device responds on onewire bus");
         } else {
-            log_warn("badness getting onewire addr : %02x%02x%02x%02x%02x%02x%02x%02x", 
+            MIO_LOG_WARN("badness getting onewire addr : %02x%02x%02x%02x%02x%02x%02x%02x", 
                     addr[0], addr[1], addr[2], addr[3], addr[4], addr[5], addr[6], addr[7]);
         }
-        return 0;
+        *temp = 0;
+        return false;
     }
 
 }
@@ -193,12 +442,88 @@ static void defineIO(int ioid, int gpio, const char* name, IO_TYPE t, GPIO_IDLE_
         // Can't check if linked guy is valid as might be initialised later on
 //        assert(_ctx.ios[doutIoid].gpio!=-1);
 //        assert(isOut(_ctx.ios[doutIoid].type));
-        // and link it
-        _ctx.ios[ioid].linkedDOUTioid = doutIoid;
+        // and link it : its just a rule to toggle the DOUT on each press
+        if (gpio>=0) {
+            defineRule(ioid, RULE_CHANGE, 0, doutIoid, RULE_ACT_TOGGLE, 0);
+        }
+        _ctx.ios[ioid].valueDL = 0;
+    } else if (t==IO_SENSOR_PWR) {
+        // off until needed, initialValue is the settle time
         _ctx.ios[ioid].valueDL = 0;
     } else {
         _ctx.ios[ioid].valueDL = initialValue;
-        _ctx.ios[ioid].linkedDOUTioid = -1;
+    }
+    // IO_FREQ must wait for the end of its gate and IO_SENSOR_PWR for its settle time, given in 100ms by initialValue
+    _ctx.ios[ioid].warmupMS = (t==IO_FREQ || t==IO_SENSOR_PWR) ? (initialValue*100) : _typeWarmupMS[t];
+}
+
+// Add a rule in the first free slot. srcIO of -1 is ignored (for syscfg default)
+static void defineRule(int srcIO, RULE_COND cond, int16_t threshold, int dstIO, RULE_ACTION action, uint16_t param) {
+    if (srcIO<0) {
+        return;
+    }
+    assert(srcIO<NB_IOS);
+    assert(dstIO>=0 && dstIO<NB_IOS);
+    for(int r=0;r<NB_RULES;r++) {
+        if (_ctx.rules[r].srcIO<0) {
+            _ctx.rules[r].srcIO = srcIO;
+            _ctx.rules[r].cond = cond;
+            _ctx.rules[r].threshold = threshold;
+            _ctx.rules[r].dstIO = dstIO;
+            _ctx.rules[r].action = action;
+            _ctx.rules[r].param = param;
+            _ctx.rules[r].condTrue = false;
+            _ctx.rules[r].primed = false;
+            return;
+        }
+    }
+    assert(0);      // MIO_NB_RULES too small for the rules defined
+}
+
+// Set an input to be read every periodSecs between ULs. ioid of -1 is ignored (for syscfg default)
+static void defineSampling(int ioid, uint32_t periodSecs) {
+    if (ioid<0) {
+        return;
+    }
+    assert(ioid<NB_IOS);
+    _ctx.ios[ioid].samplePeriodMS = periodSecs*1000;
+}
+
+// Set the conversion of a calibrated AIN from mV to its engineering unit. ioid of -1 is ignored (for syscfg default)
+static void defineAINScale(int ioid, int16_t mul, int16_t div, int16_t offset) {
+    if (ioid<0) {
+        return;
+    }
+    assert(ioid<NB_IOS);
+    assert(div!=0);
+    _ctx.ios[ioid].scaleMul = mul;
+    _ctx.ios[ioid].scaleDiv = div;
+    _ctx.ios[ioid].scaleOffset = offset;
+}
+
+static void defineSensorPower(int pwrIO, int ioid) {
+    if (ioid<0) {
+        return;
+    }
+    assert(ioid<NB_IOS);
+    assert(pwrIO>=0 && pwrIO<NB_IOS);
+    _ctx.ios[ioid].pwrIO = pwrIO;
+}
+
+static void parkPin(int gpio) {
+    if (gpio<0) {
+        return;
+    }
+    // unused pin, parked for ever. The io pins belong to the GPIO manager or to their driver
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio==gpio) {
+            MIO_LOG_WARN("MIO:pin %d is used by IO%d, not parked", gpio, i);
+            return;
+        }
+    }
+    // (not an error if the target doesn't park, eg the sim)
+    if (!pinpark_define(gpio) && MYNEWT_VAL(MIO_PIN_PARKING)) {
+        MIO_LOG_WARN("MIO:can't park pin %d", gpio);
     }
 }
 
@@ -207,31 +532,52 @@ static void initIOs() {
         if (_ctx.ios[i].gpio>=0) {
             switch (_ctx.ios[i].type) {
                 case IO_DIN: {
-                    log_info("MIO:IO%d[%s] DIN[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+                    MIO_LOG_INFO("MIO:IO%d[%s] DIN[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
                     GPIO_define_in(_ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].pull, LP_DOZE, HIGH_Z);
                     break;
                 }
                 case IO_AIN: {
-                    log_info("MIO:IO%d[%s] AIN[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+                    MIO_LOG_INFO("MIO:IO%d[%s] AIN[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+#if MYNEWT_VAL(MIO_ADC_SCAN)
+                    if (adcscan_gpioToChannel(_ctx.ios[i].gpio)<0) {
+                        MIO_LOG_WARN("MIO:IO%d gpio %d has no ADC input", i, _ctx.ios[i].gpio);
+                    }
+#endif
+                    // gpiomgr still looks after the pin for low power
                     GPIO_define_adc(_ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].gpio, LP_DOZE, HIGH_Z);
                     break;
                 }
                 case IO_DS18B20: {
-                    log_info("MIO:IO%d[%s] DS18B20[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+                    MIO_LOG_INFO("MIO:IO%d[%s] DS18B20[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
                     // define as input in gpio mgr for low power management
                     GPIO_define_in(_ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].pull, LP_DOZE, HIGH_Z);
-                    uint32_t val = ds18B20_read(_ctx.ios[i].gpio);
-                    log_info("DS18B20 reads value %d", val);
+                    // sensor is probed by probeIOs()
+                    break;
+                }
+                case IO_COUNTER: {
+                    // initial value is the debounce time in ms
+                    MIO_LOG_INFO("MIO:IO%d[%s] COUNTER[%d] debounce %d ms", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL);
+                    if (!pulsein_defineCounter(i, _ctx.ios[i].gpio, halPull(_ctx.ios[i].pull), _ctx.ios[i].valueDL)) {
+                        MIO_LOG_WARN("MIO:IO%d failed to setup counter interrupt", i);
+                    }
+                    break;
+                }
+                case IO_FREQ: {
+                    // initial value is the gate time in 100ms
+                    MIO_LOG_INFO("MIO:IO%d[%s] FREQ[%d] gate %d00 ms", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL);
+                    if (!pulsein_defineFreq(i, _ctx.ios[i].gpio, halPull(_ctx.ios[i].pull))) {
+                        MIO_LOG_WARN("MIO:IO%d failed to setup freq interrupt", i);
+                    }
                     break;
                 }
                 case IO_USDIST_TRIG: {
-                    log_info("MIO:IO%d[%s] USDIST_TRIG[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+                    MIO_LOG_INFO("MIO:IO%d[%s] USDIST_TRIG[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
                     // define as ?? to drive US distance measurment sensor
                     GPIO_define_out(_ctx.ios[i].name, _ctx.ios[i].gpio, 0, LP_DOZE, HIGH_Z);
                     break;
                 }
                 case IO_USDIST_INTR: {
-                    log_info("MIO:IO%d[%s] USDIST_INTR[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+                    MIO_LOG_INFO("MIO:IO%d[%s] USDIST_INTR[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
                     // define as ?? to drive US distance measurment sensor
                     GPIO_define_in(_ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].pull, LP_DOZE, HIGH_Z);
                     break;
@@ -240,27 +586,33 @@ static void initIOs() {
                 case IO_BUTTON: 
                 case IO_BUTTON_LINKED:          // same button setup for both
                 {
-                    log_info("MIO:IO%d[%s] BUTTON[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+                    MIO_LOG_INFO("MIO:IO%d[%s] BUTTON[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
                     SRMgr_defineButton(_ctx.ios[i].gpio);
                     // add cb for button press, context is id
                     SRMgr_registerButtonCB(_ctx.ios[i].gpio, buttonChangeCB, (void*)i);
                     break;
                 }
                 case IO_STATE: {
-                    log_info("MIO:IO%d[%s] STATE[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
+                    MIO_LOG_INFO("MIO:IO%d[%s] STATE[%d]", i, _ctx.ios[i].name, _ctx.ios[i].gpio);
                     SRMgr_defineButton(_ctx.ios[i].gpio);
                     // add cb for change of state, context is id
                     SRMgr_registerButtonCB(_ctx.ios[i].gpio, stateInputChangeCB, (void*)i);
                     break;
                 }
                 case IO_DOUT: {
-                    log_info("MIO:IO%d[%s] DOUT[%d]=%d", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL);
+                    MIO_LOG_INFO("MIO:IO%d[%s] DOUT[%d]=%d", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL);
                     // config
                     GPIO_define_out(_ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL, LP_DOZE, HIGH_Z);
                     break;
                 }
+                case IO_SENSOR_PWR: {
+                    MIO_LOG_INFO("MIO:IO%d[%s] SENSOR_PWR[%d] settle %d ms", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].warmupMS);
+                    // off between measurements
+                    GPIO_define_out(_ctx.ios[i].name, _ctx.ios[i].gpio, 0, LP_DOZE, HIGH_Z);
+                    break;
+                }
                 case IO_PWMOUT: {
-                    log_info("MIO:IO%d[%s] PWMOUT[%d]=%d", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL);
+                    MIO_LOG_INFO("MIO:IO%d[%s] PWMOUT[%d]=%d", i, _ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL);
                     // using timer 2 TODO how to find out? using initial value as hack
                     PWM_define(_ctx.ios[i].name, _ctx.ios[i].gpio, _ctx.ios[i].valueDL);
                     // Play a little tune to say hello
@@ -275,20 +627,82 @@ static void initIOs() {
         }
     }
 }
+// Check the sensors answer (slow, so deferred to the first start with fast boot)
+static void probeIOs() {
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==IO_DS18B20) {
+            int32_t val;
+            AWAKE_TIMED(AWAKE_ONEWIRE, ds18B20_read(_ctx.ios[i].gpio, &val));
+            MIO_LOG_INFO("DS18B20 reads value %d", val);
+        }
+    }
+    _ctx.probed = true;
+}
+
 static void deinitIOs() {
-    // Not required, GPIO mgr takes care of low powering
+    // GPIO mgr takes care of low powering its pins, we park the unused ones
+    pinpark_parkAll();
+    // except the 1-Wire pins, left floating by the last transaction : onewireInit() sets them up again for the next one
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==IO_DS18B20) {
+            pinpark_idle(_ctx.ios[i].gpio, halPull(_ctx.ios[i].pull));
+        }
+    }
+#if MYNEWT_VAL(MIO_LP_REPORT)
+    // once, at the first sleep after boot : logging every pin on each sleep would keep us awake for it
+    if (!_ctx.lpReported) {
+        _ctx.lpReported = true;
+        pinpark_report();
+    }
+#endif
 }
 
-// start an io if sensor requires it
-static uint8_t startIO(int ioid) {
+// start an io if sensor requires it, returns the time in ms it needs before it can be read (0 if it was not started)
+// Sensors that signal the end of their acquisition call ioReady()
+static uint32_t startIO(int ioid) {
     if (ioid>=0 && ioid<NB_IOS) {
+        bool started = false;
         if (_ctx.ios[ioid].gpio>=0) {
             switch (_ctx.ios[ioid].type) {
                 case IO_DS18B20: {
-                    if (ds18B20_broadcastConvert(_ctx.ios[ioid].gpio)) {
-                        log_info("DS18B20 on %d init and broadcast convert ok", _ctx.ios[ioid].gpio);
+                    bool ok;
+                    AWAKE_TIMED(AWAKE_ONEWIRE, ok = ds18B20_broadcastConvert(_ctx.ios[ioid].gpio));
+                    if (ok) {
+                        MIO_LOG_INFO("DS18B20 on %d init and broadcast convert ok", _ctx.ios[ioid].gpio);
+                        started = true;
                     } else {
-                        log_info("DS18B20 on %d no response from init when trying to start", _ctx.ios[ioid].gpio);
+                        // no point waiting for it
+                        MIO_LOG_INFO("DS18B20 on %d no response from init when trying to start", _ctx.ios[ioid].gpio);
+                    }
+                    break;
+                }
+                case IO_FREQ: {
+                    // measured during the gate, read gets the result (valid once the gate closes). If the gate is already 
+                    // running for the other path (sampling or UL) it is left alone : its result is still pending, so our read 
+                    // has none, and the other path gets it
+                    started = pulsein_startFreq(ioid, _ctx.ios[ioid].valueDL*100, freqDone);
+                    if (started) {
+                        _ctx.ios[ioid].measureValid = false;
+                    } else {
+                        MIO_LOG_WARN("MIO:IO%d freq gate already running", ioid);
+                    }
+                    break;
+                }
+                case IO_USDIST_TRIG: {
+                    // burst runs in the background, read gets the result
+                    int echoId = findIO(IO_USDIST_INTR);
+                    if (echoId<0) {
+                        MIO_LOG_WARN("MIO:IO%d US distance has no USDIST_INTR io", ioid);
+                        break;
+                    }
+                    // cleared first as the burst can end in the call. A burst already running (for the other path) keeps 
+                    // its pending result
+                    uint32_t prevEchoUS = _ctx.ios[ioid].echoUS;
+                    _ctx.ios[ioid].echoUS = 0;
+                    started = usdist_startMeasure(_ctx.ios[ioid].gpio, _ctx.ios[echoId].gpio, halPull(_ctx.ios[echoId].pull), 
+                                    MYNEWT_VAL(MIO_USDIST_PINGS), usdistDone, (void*)ioid);
+                    if (!started) {
+                        _ctx.ios[ioid].echoUS = prevEchoUS;
                     }
                     break;
                 }
@@ -298,30 +712,162 @@ static uint8_t startIO(int ioid) {
                 }
             }
         }
-        return _ctx.ios[ioid].valueUL;
+        return (started ? _ctx.ios[ioid].warmupMS : 0);
     }
     return 0;
 }
 
+// Read an io whose acquisition is finished, so getData doesn't need to
+static void collectIO(int ioid) {
+    readIO(ioid);
+    _ctx.ios[ioid].acquired = true;
+}
+
+// A sensor started by startIOs has its result : collect it, and tell app-core we are done once they all have
+static void ioReady(int ioid) {
+    if (ioid<0 || ioid>=NB_IOS || !_ctx.ios[ioid].warming) {
+        return;         // not started by startIOs (sampling), or start phase already over
+    }
+    _ctx.ios[ioid].warming = false;
+    // a distance needs the temperature of this cycle : it is converted by readIOs, once the DS18B20 is read
+    if (_ctx.ios[ioid].type!=IO_USDIST_TRIG) {
+        collectIO(ioid);
+    }
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].warming) {
+            return;
+        }
+    }
+    os_callout_stop(&_ctx.warmupTimer);
+    if (WARMUP_POLL_MS>0) {
+        MIO_LOG_DEBUG("MIO:sensors ready early");
+        AppCore_module_done(MY_MOD_ID);
+    }
+}
+
+static void freqDone(int ioid) {
+    if (ioid>=0 && ioid<NB_IOS) {
+        _ctx.ios[ioid].measureValid = true;
+    }
+    ioReady(ioid);
+}
+
+static void usdistDone(void* ctx, uint32_t echoUS) {
+    int ioid = (int)ctx;
+    if (ioid>=0 && ioid<NB_IOS) {
+        _ctx.ios[ioid].echoUS = echoUS;
+    }
+    ioReady(ioid);
+}
+
+// Poll the started sensors that can't signal they are ready (DS18B20 conversion)
+static void warmupCheck(struct os_event* e) {
+    bool waiting = false;
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].warming && _ctx.ios[i].type==IO_DS18B20) {
+            bool done;
+            AWAKE_TIMED(AWAKE_ONEWIRE, done = ds18B20_isConversionDone(_ctx.ios[i].gpio));
+            if (done) {
+                ioReady(i);
+            } else {
+                waiting = true;
+            }
+        }
+    }
+    if (waiting) {
+        os_callout_reset(&_ctx.warmupTimer, os_time_ms_to_ticks32(WARMUP_POLL_MS));
+    }
+}
+
 // Read an io
 static uint8_t readIO(int ioid) {
     if (ioid>=0 && ioid<NB_IOS) {
         if (_ctx.ios[ioid].gpio>=0) {
+            PROF_START(t);
             switch (_ctx.ios[ioid].type) {
                 case IO_DIN: {
-                    _ctx.ios[ioid].valueUL = (uint8_t)GPIO_read(_ctx.ios[ioid].gpio);
+                    _ctx.ios[ioid].measure = GPIO_read(_ctx.ios[ioid].gpio);
+                    _ctx.ios[ioid].valueUL = (uint8_t)_ctx.ios[ioid].measure;
+                    mio_trace_sample(ioid, _ctx.ios[ioid].measure, true);
+                    evaluateRules(ioid, false);
+                    PROF_END(PROF_READ_DIN, t);
                     break;
                 }
                 case IO_AIN: {
-                    _ctx.ios[ioid].valueUL = (uint8_t)GPIO_readADC(_ctx.ios[ioid].gpio);
+#if MYNEWT_VAL(MIO_ADC_SCAN)
+                    // 1 scan converts all the AINs, unless already done for this read of all ios
+                    if (!_ctx.ainScanned) {
+                        scanAINs();
+                    }
+#else
+                    AWAKE_TIMED(AWAKE_ADC, _ctx.ios[ioid].measure = GPIO_readADC(_ctx.ios[ioid].gpio));
+#endif
+                    _ctx.ios[ioid].valueUL = (uint8_t)_ctx.ios[ioid].measure;
+                    mio_trace_sample(ioid, _ctx.ios[ioid].measure, true);
+                    evaluateRules(ioid, false);
+                    addSample(ioid);
+                    PROF_END(PROF_READ_AIN, t);
                     break;
                 }
                 case IO_DS18B20: {
-                    _ctx.ios[ioid].valueUL = ds18B20_read(_ctx.ios[ioid].gpio);
+                    AWAKE_TIMED(AWAKE_ONEWIRE, _ctx.ios[ioid].measureValid = ds18B20_read(_ctx.ios[ioid].gpio, &_ctx.ios[ioid].measure));
+                    _ctx.ios[ioid].valueUL = (uint8_t)_ctx.ios[ioid].measure;
+                    mio_trace_sample(ioid, _ctx.ios[ioid].measure, _ctx.ios[ioid].measureValid);
+                    // no reading (probe missing) : the rules keep their outputs as they are
+                    if (_ctx.ios[ioid].measureValid) {
+                        evaluateRules(ioid, false);
+                        addSample(ioid);
+                    }
+                    PROF_END(PROF_READ_DS18B20, t);
+                    break;
+                }
+                case IO_COUNTER: {
+                    // value is the number of pulses since the last UL
+                    _ctx.ios[ioid].count = pulsein_getCount(ioid);
+                    _ctx.ios[ioid].measure = _ctx.ios[ioid].count - _ctx.ios[ioid].countAtUL;
+                    _ctx.ios[ioid].valueUL = (_ctx.ios[ioid].measure>0xFF)?0xFF:_ctx.ios[ioid].measure;
+                    mio_trace_sample(ioid, _ctx.ios[ioid].measure, true);
+                    evaluateRules(ioid, false);
+                    PROF_END(PROF_READ_COUNTER, t);
+                    break;
+                }
+                case IO_FREQ: {
+                    // gate still running (not ours, or not closed yet) : the rules keep their outputs as they are
+                    if (_ctx.ios[ioid].measureValid) {
+                        uint32_t periodUS = pulsein_getPeriodUS(ioid);
+#if MYNEWT_VAL(MIO_FREQ_AS_PERIOD)
+                        _ctx.ios[ioid].measure = periodUS;
+#else
+                        // in 1/10 Hz
+                        _ctx.ios[ioid].measure = (periodUS>0)?(10000000/periodUS):0;
+#endif
+                        _ctx.ios[ioid].valueUL = (_ctx.ios[ioid].measure>0xFF)?0xFF:_ctx.ios[ioid].measure;
+                    }
+                    mio_trace_sample(ioid, _ctx.ios[ioid].measure, _ctx.ios[ioid].measureValid);
+                    if (_ctx.ios[ioid].measureValid) {
+                        evaluateRules(ioid, false);
+                        addSample(ioid);
+                    }
+                    PROF_END(PROF_READ_FREQ, t);
                     break;
                 }
                 case IO_USDIST_TRIG: {
-                    _ctx.ios[ioid].valueUL = usdist_read(0,0);
+                    // result of the last burst (started by startIO)
+                    uint32_t echoUS = _ctx.ios[ioid].echoUS;
+                    // distance in mm, 0 if no valid echo. Speed of sound corrected with the air temperature if we have it
+                    int32_t temp16 = USDIST_DEFAULT_TEMP16;
+                    if (USDIST_TEMP_IO>=0 && _ctx.ios[USDIST_TEMP_IO].type==IO_DS18B20 && _ctx.ios[USDIST_TEMP_IO].measureValid) {
+                        temp16 = _ctx.ios[USDIST_TEMP_IO].measure;
+                    }
+                    _ctx.ios[ioid].measure = usdist_echoToMM(echoUS, temp16);
+                    _ctx.ios[ioid].measureValid = (echoUS>0);
+                    mio_trace_sample(ioid, _ctx.ios[ioid].measure, _ctx.ios[ioid].measureValid);
+                    _ctx.ios[ioid].valueUL = (_ctx.ios[ioid].measure/10>0xFF)?0xFF:(_ctx.ios[ioid].measure/10);
+                    if (_ctx.ios[ioid].measureValid) {
+                        evaluateRules(ioid, false);
+                        addSample(ioid);
+                    }
+                    PROF_END(PROF_READ_USDIST, t);
                     break;
                 }
                 // Button dealt with by callback, its value is the last press type (not the press/release 1/0 value)
@@ -340,13 +886,17 @@ static void writeIO(int ioid) {
     if (ioid>=0 && ioid<NB_IOS) {
         if (_ctx.ios[ioid].gpio>=0) {
             switch (_ctx.ios[ioid].type) {
-                case IO_DOUT: {
+                case IO_DOUT: 
+                case IO_SENSOR_PWR: {
                     GPIO_write(_ctx.ios[ioid].gpio, _ctx.ios[ioid].valueDL);
                     break;
                 }
                 case IO_PWMOUT: {
                     // value is bits 7-5 = duration in seconds-1, bits 4-0 = frequency in 1kHz
-                    PWM_addPWM(_ctx.ios[ioid].gpio, (_ctx.ios[ioid].valueDL & 0x1F)*100, 50, (((_ctx.ios[ioid].valueDL & 0xE0)>>5)+1)*1000);
+                    uint32_t durationMS = (((_ctx.ios[ioid].valueDL & 0xE0)>>5)+1)*1000;
+                    PWM_addPWM(_ctx.ios[ioid].gpio, (_ctx.ios[ioid].valueDL & 0x1F)*100, 50, durationMS);
+                    // the timer keeps the cpu out of deep sleep while playing
+                    awake_add(AWAKE_PWM, durationMS*1000);
                     break;
                 }
                 default: {
@@ -358,82 +908,777 @@ static void writeIO(int ioid) {
     }    
 }
 
-// Read all input type IOs
+// Read all input type IOs, except those already collected during the start phase
 static void readIOs() {
+    PROF_START(t);
+#if MYNEWT_VAL(MIO_ADC_SCAN)
+    if (!_ctx.ainScanned) {
+        scanAINs();
+        _ctx.ainScanned = true;
+    }
+#endif
+    // the distances last, as they are corrected with the temperature read in this cycle
+    for(int pass=0;pass<2;pass++) {
+        for(int i=0;i<NB_IOS;i++) {
+            if ((_ctx.ios[i].type==IO_USDIST_TRIG)==(pass==1) && !_ctx.ios[i].acquired) {
+                readIO(i);      // deals with invalid or output cases by ignoring them
+            }
+        }
+    }
     for(int i=0;i<NB_IOS;i++) {
-        readIO(i);      // deals with invalid or output cases by ignoring them
+        _ctx.ios[i].acquired = false;
     }
+    _ctx.ainScanned = false;
+    PROF_END(PROF_READIOS, t);
 }
 
-// initialise/start ios that require time to do their stuff
-static void startIOs() {
+// Start the sensors powered by an IO_SENSOR_PWR io, or the others, returns the time needed by the slowest one
+static uint32_t startSensors(bool powered) {
+    uint32_t maxWarmupMS = 0;
+    bool poll = false;
     for(int i=0;i<NB_IOS;i++) {
-        startIO(i);      // deals with invalid or output cases by ignoring them
+        if ((_ctx.ios[i].pwrIO>=0)!=powered) {
+            continue;
+        }
+        uint32_t w = startIO(i);      // deals with invalid or output cases by ignoring them
+        _ctx.ios[i].warming = (w>0);
+        if (w>maxWarmupMS) {
+            maxWarmupMS = w;
+        }
+        if (w>0 && _ctx.ios[i].type==IO_DS18B20) {
+            poll = true;
+        }
+    }
+#if MYNEWT_VAL(MIO_ADC_SCAN)
+    // The scan is short : do it now while the slow sensors are busy (once all the AINs are powered)
+    bool poweredAIN = false;
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==IO_AIN && _ctx.ios[i].pwrIO>=0) {
+            poweredAIN = true;
+        }
+    }
+    if (poweredAIN==powered) {
+        scanAINs();
+        _ctx.ainScanned = true;
+        for(int i=0;i<NB_IOS;i++) {
+            if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==IO_AIN) {
+                collectIO(i);
+            }
+        }
+    }
+#endif
+    if (poll && WARMUP_POLL_MS>0) {
+        os_callout_reset(&_ctx.warmupTimer, os_time_ms_to_ticks32(WARMUP_POLL_MS));
+    }
+    return maxWarmupMS;
+}
+
+// initialise/start ios that require time to do their stuff, all at once so the start phase only lasts as long as the slowest one.
+// Returns the time it needs. Each sensor is collected as soon as it is ready.
+static uint32_t startIOs() {
+    _ctx.ainScanned = false;
+    for(int i=0;i<NB_IOS;i++) {
+        _ctx.ios[i].acquired = false;
+        _ctx.ios[i].warming = false;
+    }
+    uint32_t settleMS = sensorPower(true);
+    uint32_t maxWarmupMS = startSensors(false);
+    if (settleMS==0) {
+        uint32_t w = startSensors(true);
+        return (w>maxWarmupMS) ? w : maxWarmupMS;
+    }
+    // powered sensors are started once their supply has settled
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].pwrIO>=0 && (settleMS+_ctx.ios[i].warmupMS)>maxWarmupMS) {
+            maxWarmupMS = settleMS+_ctx.ios[i].warmupMS;
+        }
+    }
+    return (settleMS>maxWarmupMS) ? settleMS : maxWarmupMS;
+}
+
+// Drive the IO_SENSOR_PWR ios, returns the longest settle time when switching on
+static uint32_t sensorPower(bool on) {
+    uint32_t settleMS = 0;
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==IO_SENSOR_PWR) {
+            // explicit set cancels any timed operation on the io
+            os_callout_stop(&_ctx.ios[i].timer);
+            _ctx.ios[i].valueDL = (on?1:0);
+            writeIO(i);
+            // the start phase can't end before the supply has settled
+            _ctx.ios[i].warming = (on && _ctx.ios[i].warmupMS>0);
+            if (on && _ctx.ios[i].warmupMS>settleMS) {
+                settleMS = _ctx.ios[i].warmupMS;
+            }
+        }
+    }
+    if (settleMS>0) {
+        os_callout_reset(&_ctx.pwrTimer, os_time_ms_to_ticks32(settleMS));
+    } else {
+        os_callout_stop(&_ctx.pwrTimer);
+    }
+    return settleMS;
+}
+
+// Sensor supplies have settled, start the sensors they power
+static void sensorPowerSettled(struct os_event* e) {
+    startSensors(true);
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].type==IO_SENSOR_PWR) {
+            ioReady(i);
+        }
     }
 }
 // DL action setting output ios
 static void iosetAction(uint8_t* v, uint8_t l) {
+    PROF_START(t);
+    mio_trace_dl(DL_APP_IO_SET, v, l);
     // Check got the right number of bytes
     if (l==NB_IOS) {
         for(int i=0;i<NB_IOS; i++) {
             if (isOut(_ctx.ios[i].type)) {
+                // explicit set cancels any timed operation on the io
+                os_callout_stop(&_ctx.ios[i].timer);
                 _ctx.ios[i].valueDL = v[i];
                 writeIO(i);
-                log_info("DL io %d on gpio %d set to %d", i, _ctx.ios[i].gpio, v[i]);
+                MIO_LOG_INFO("DL io %d on gpio %d set to %d", i, _ctx.ios[i].gpio, v[i]);
             }
         }
-        log_info("DL ios set");
+        MIO_LOG_INFO("DL ios set");
     } else {
-        log_warn("DL ios not set as wrong length %d", l);
+        MIO_LOG_WARN("DL ios not set as wrong length %d", l);
+    }
+    PROF_END(PROF_IOSET, t);
+}
+
+// DL action setting only some output ios : first byte is the mask of ios to set, then 1 value byte per bit set (lowest io first)
+static void iosetmaskAction(uint8_t* v, uint8_t l) {
+    mio_trace_dl(DL_APP_IO_SETMASK, v, l);
+    if (l<1) {
+        MIO_LOG_WARN("DL ios mask not set as empty");
+        return;
+    }
+    uint8_t mask = v[0];
+    int nbVals = 0;
+    for(int i=0;i<NB_IOS; i++) {
+        if (mask & (1<<i)) {
+            nbVals++;
+        }
+    }
+    if (l!=(nbVals+1)) {
+        MIO_LOG_WARN("DL ios mask %02x not set as wrong length %d", mask, l);
+        return;
+    }
+    int vi = 1;
+    for(int i=0;i<NB_IOS; i++) {
+        if (mask & (1<<i)) {
+            uint8_t val = v[vi++];
+            if (!isOut(_ctx.ios[i].type)) {
+                MIO_LOG_WARN("DL io %d is not an output", i);
+                continue;
+            }
+            // explicit set cancels any timed operation on the io
+            os_callout_stop(&_ctx.ios[i].timer);
+            if (_ctx.ios[i].valueDL==val) {
+                // don't restart a PWM or re-drive a relay for nothing
+                MIO_LOG_DEBUG("DL io %d unchanged at %d", i, val);
+            } else {
+                _ctx.ios[i].valueDL = val;
+                writeIO(i);
+                MIO_LOG_INFO("DL io %d on gpio %d set to %d", i, _ctx.ios[i].gpio, val);
+            }
+        }
+    }
+}
+
+// DL action for a timed operation on 1 output, executed locally so no second DL is needed:
+// b0 : io id, b1 : mode (TIMED_MODE), b2 : value, b3-b4 : time (uint16, LSB first)
+// TIMED_SET_FOR_SECS : set value now, back to previous value after time seconds
+// TIMED_PULSE_MS : set value now, back to previous value after time ms
+// TIMED_SET_AFTER_SECS : set value after time seconds
+static void iotimedAction(uint8_t* v, uint8_t l) {
+    mio_trace_dl(DL_APP_IO_TIMED, v, l);
+    if (l!=5) {
+        MIO_LOG_WARN("DL timed io not set as wrong length %d", l);
+        return;
+    }
+    startTimedIO(v[0], v[1], v[2], v[3] + (v[4] << 8));
+}
+
+// Start a timed operation on an output (see iotimedAction), cancelling any current one
+static bool startTimedIO(int ioid, uint8_t mode, uint8_t val, uint32_t t) {
+    if (ioid<0 || ioid>=NB_IOS || !isOut(_ctx.ios[ioid].type)) {
+        MIO_LOG_WARN("MIO:timed io %d is not an output", ioid);
+        return false;
+    }
+    // if already in a timed operation, the value to go back to is the one from before it
+    uint8_t prevValue = (os_callout_queued(&_ctx.ios[ioid].timer) ? _ctx.ios[ioid].timedValue : _ctx.ios[ioid].valueDL);
+    os_callout_stop(&_ctx.ios[ioid].timer);
+    uint32_t ms;
+    switch(mode) {
+        case TIMED_SET_FOR_SECS: {
+            ms = t*1000;
+            _ctx.ios[ioid].timedValue = prevValue;
+            break;
+        }
+        case TIMED_PULSE_MS: {
+            ms = t;
+            _ctx.ios[ioid].timedValue = prevValue;
+            break;
+        }
+        case TIMED_SET_AFTER_SECS: {
+            ms = t*1000;
+            _ctx.ios[ioid].timedValue = val;
+            break;
+        }
+        default: {
+            MIO_LOG_WARN("MIO:timed io %d bad mode %d", ioid, mode);
+            return false;
+        }
+    }
+    if (mode!=TIMED_SET_AFTER_SECS) {
+        _ctx.ios[ioid].valueDL = val;
+        writeIO(ioid);
+    }
+    os_callout_reset(&_ctx.ios[ioid].timer, os_time_ms_to_ticks32(ms));
+    MIO_LOG_INFO("MIO:timed io %d mode %d value %d for %d ms", ioid, mode, val, ms);
+    return true;
+}
+
+// timed operation done on an output
+static void timedIOExpiry(struct os_event* e) {
+    int ioid = (int)(e->ev_arg);
+    if (ioid>=0 && ioid<NB_IOS) {
+        _ctx.ios[ioid].valueDL = _ctx.ios[ioid].timedValue;
+        writeIO(ioid);
+        MIO_LOG_INFO("MIO:timed io %d now %d", ioid, _ctx.ios[ioid].valueDL);
     }
 }
 
 // callback each time button changes state
 static void buttonChangeCB(void* ctx, SR_BUTTON_STATE_t currentState, SR_BUTTON_PRESS_TYPE_t currentPressType) {
+    PROF_START(t);
+    mio_trace_input(TR_BUTTON, (int)ctx, currentState, currentPressType);
     if (currentState==SR_BUTTON_RELEASED) {
         if (AppCore_isDeviceActive()) {
             // flag the button that caused the UL
             int bid = (int)ctx;
             if (bid>=0 && bid<NB_IOS) {
-                log_info("MIO:button [%s] released, duration %d ms, press type:%d", _ctx.ios[bid].name, 
+                MIO_LOG_INFO("MIO:button [%s] released, duration %d ms, press type:%d", _ctx.ios[bid].name, 
                     (SRMgr_getLastButtonReleaseTS(_ctx.ios[bid].gpio)-SRMgr_getLastButtonPressTS(_ctx.ios[bid].gpio)),
                     SRMgr_getLastButtonPressType(_ctx.ios[bid].gpio));
                 _ctx.ios[bid].valueUL = currentPressType;
-                // ask for immediate UL with only us consulted
-                AppCore_forceUL(MY_MOD_ID);
-                // Check if this button is linked to a DOUT for local toggle
-                if (_ctx.ios[bid].type==IO_BUTTON_LINKED && _ctx.ios[bid].linkedDOUTioid>=0) {
-                    int doutId = _ctx.ios[bid].linkedDOUTioid;
-                    // Toggle output value (downlink set value)
-                    _ctx.ios[doutId].valueDL = !(_ctx.ios[doutId].valueDL);
-                    writeIO(doutId);
-                    log_info("MIO:button %s toggles linked dout[%s] to %d", _ctx.ios[bid].name,_ctx.ios[doutId].name, _ctx.ios[doutId].valueDL);
-                }
+                _ctx.ios[bid].measure = currentPressType;
+                recordEvent(bid, currentPressType);
+                // ask for UL with only us consulted (merged with any other changes in the coalescing window)
+                requestForcedUL();
+                // local actions (eg toggle of linked DOUT)
+                evaluateRules(bid, true);
             } else {
-                log_warn("MIO:button release but bad id %d", ctx);
+                MIO_LOG_WARN("MIO:button release but bad id %d", ctx);
             }
         } else {
-            log_info("MIO:button release ignore not active");
+            MIO_LOG_INFO("MIO:button release ignore not active");
         }
     } else {
-        log_info("MIO:button pressed");
+        MIO_LOG_INFO("MIO:button pressed");
     }
+    PROF_END(PROF_BUTTON_CB, t);
 }
 
 // For an input where we want to signal each change of state 
 static void stateInputChangeCB(void* ctx, SR_BUTTON_STATE_t currentState, SR_BUTTON_PRESS_TYPE_t currentPressType) {
+    PROF_START(t);
+    mio_trace_input(TR_STATE, (int)ctx, currentState, currentPressType);
     if (AppCore_isDeviceActive()) {
         // find input that caused the state change
         int bid = (int)ctx;
         if (bid>=0 && bid<NB_IOS) {
-            log_info("MIO:state input %d changed to %d", bid, currentState);
+            MIO_LOG_INFO("MIO:state input %d changed to %d", bid, currentState);
             _ctx.ios[bid].valueUL = currentState;
-            // ask for immediate UL with only us consulted
-            AppCore_forceUL(MY_MOD_ID);
+            _ctx.ios[bid].measure = currentState;
+            recordEvent(bid, currentState);
+            // ask for UL with only us consulted (merged with any other changes in the coalescing window)
+            requestForcedUL();
+            evaluateRules(bid, true);
+        } else {
+            MIO_LOG_WARN("MIO:input state change but bad id %d", ctx);
+        }
+    } else {
+        MIO_LOG_INFO("MIO:input state change ignore not active");
+    }
+    PROF_END(PROF_STATE_CB, t);
+}
+
+// An input change wants a UL : the first change arms the coalescing window, any others during it just ride along in the same UL
+static void requestForcedUL() {
+    if (_ctx.forceULPending) {
+        _ctx.nbEventsMerged++;
+        MIO_LOG_DEBUG("MIO:change merged into pending UL");
+        return;
+    }
+    _ctx.forceULPending = true;
+    if (FORCEUL_COALESCE_MS>0) {
+        os_callout_reset(&_ctx.forceULTimer, os_time_ms_to_ticks32(FORCEUL_COALESCE_MS));
+    } else {
+        forceULTimeout(NULL);
+    }
+}
+
+// Coalescing window is over : send the UL if the token bucket lets us
+static void forceULTimeout(struct os_event* e) {
+    _ctx.forceULPending = false;
+    // refill bucket with 1 token per elapsed refill period
+    uint32_t now = TMMgr_getRelTimeMS();
+    if (FORCEUL_REFILL_MS==0 || _ctx.forceULTokens>=FORCEUL_BUCKET_SIZE) {
+        // no rate limit or bucket full : refill period starts from now
+        _ctx.forceULTokens = FORCEUL_BUCKET_SIZE;
+        _ctx.lastRefillTS = now;
+    } else {
+        uint32_t nbRefills = (now - _ctx.lastRefillTS) / FORCEUL_REFILL_MS;
+        if (nbRefills>0) {
+            _ctx.forceULTokens = (nbRefills >= (uint32_t)(FORCEUL_BUCKET_SIZE-_ctx.forceULTokens)) ? FORCEUL_BUCKET_SIZE : (_ctx.forceULTokens+nbRefills);
+            _ctx.lastRefillTS += nbRefills*FORCEUL_REFILL_MS;
+        }
+    }
+    if (_ctx.forceULTokens>0) {
+        _ctx.forceULTokens--;
+        _ctx.nbForcedULs++;
+        // ask for immediate UL with only us consulted
+        AppCore_forceUL(MY_MOD_ID);
+    } else {
+        // values stay latched and go up on next UL
+        _ctx.nbForcedULsLimited++;
+        MIO_LOG_WARN("MIO:forced UL rate limited");
+    }
+}
+
+// Keep each input change with its time, so that several changes between ULs are not lost
+static void recordEvent(int ioid, uint8_t value) {
+#if EVENT_BUF_SIZE>0
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if (_ctx.evCount>=EVENT_BUF_SIZE) {
+        // full : drop oldest
+        _ctx.evFirst = (_ctx.evFirst+1) % EVENT_BUF_SIZE;
+        _ctx.evCount--;
+        if (_ctx.nbEventsLost<0xFFFF) {
+            _ctx.nbEventsLost++;
+        }
+    }
+    struct mioevent* ev = &_ctx.events[(_ctx.evFirst+_ctx.evCount) % EVENT_BUF_SIZE];
+    ev->ts = TMMgr_getRelTimeMS();
+    ev->ioid = ioid;
+    ev->value = value;
+    _ctx.evCount++;
+    OS_EXIT_CRITICAL(sr);
+#endif
+}
+
+// Drain the oldest events into the UL : any left over go in the next UL
+static void addEventsUL(APP_CORE_UL_t* ul) {
+#if EVENT_BUF_SIZE>0
+    /* structure equiv:
+     * uint8_t nb events lost (buffer overflow) since last UL, saturates at 255
+     * then per event, oldest first:
+     * uint8_t ioid in bits 7-5, value in bits 4-0
+     * uint16_t age in seconds at UL time (LSB first), saturates at 65535
+     */
+    uint8_t evs[1+(EVENT_UL_MAX*3)];
+    int len = 1;
+    // only as many events as the UL has room for
+    int max = 0;
+    while(max<EVENT_UL_MAX && fitsUL(1+(max+1)*3)) {
+        max++;
+    }
+    if (max==0) {
+        return;
+    }
+    uint32_t now = TMMgr_getRelTimeMS();
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if (_ctx.evCount==0 && _ctx.nbEventsLost==0) {
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+    evs[0] = (_ctx.nbEventsLost>0xFF)?0xFF:_ctx.nbEventsLost;
+    _ctx.nbEventsLost = 0;
+    for(int i=0;i<max && _ctx.evCount>0;i++) {
+        struct mioevent* ev = &_ctx.events[_ctx.evFirst];
+        uint32_t age = (now - ev->ts)/1000;
+        if (age>0xFFFF) {
+            age = 0xFFFF;
+        }
+        evs[len++] = ((ev->ioid & 0x07) << 5) | (ev->value & 0x1F);
+        evs[len++] = age & 0xFF;
+        evs[len++] = (age >> 8) & 0xFF;
+        _ctx.evFirst = (_ctx.evFirst+1) % EVENT_BUF_SIZE;
+        _ctx.evCount--;
+    }
+    OS_EXIT_CRITICAL(sr);
+    MIO_LOG_INFO("MIO: UL %d events, lost %d", (len-1)/3, evs[0]);
+    addTLV(ul, UL_APP_IO_EVENTS, len, &evs[0]);
+#endif
+}
+
+// DL action to change a rule :
+// b0 : rule index, then either nothing to remove the rule, or
+// b1 : src io, b2 : condition (RULE_COND), b3-b4 : threshold (int16, LSB first), b5 : dst io, b6 : action (RULE_ACTION), b7-b8 : param (uint16, LSB first)
+static void ioruleAction(uint8_t* v, uint8_t l) {
+    mio_trace_dl(DL_APP_IO_RULE, v, l);
+    if (l<1 || v[0]>=NB_RULES) {
+        MIO_LOG_WARN("DL rule bad index");
+        return;
+    }
+    struct miorule* rule = &_ctx.rules[v[0]];
+    if (l==1) {
+        rule->srcIO = -1;
+        MIO_LOG_INFO("DL rule %d removed", v[0]);
+    } else if (l==9) {
+        if (v[1]>=NB_IOS || v[5]>=NB_IOS || _ctx.ios[v[5]].gpio<0 || !isOut(_ctx.ios[v[5]].type)) {
+            MIO_LOG_WARN("DL rule %d bad io %d/%d", v[0], v[1], v[5]);
+            return;
+        }
+        if (v[2]<RULE_GT || v[2]>RULE_CHANGE || v[6]>RULE_ACT_PULSE) {
+            MIO_LOG_WARN("DL rule %d bad cond %d or action %d", v[0], v[2], v[6]);
+            return;
+        }
+        rule->srcIO = v[1];
+        rule->cond = v[2];
+        rule->threshold = (int16_t)(v[3] + (v[4] << 8));
+        rule->dstIO = v[5];
+        rule->action = v[6];
+        rule->param = v[7] + (v[8] << 8);
+        rule->condTrue = false;
+        rule->primed = false;
+        MIO_LOG_INFO("DL rule %d set : io %d cond %d/%d -> io %d action %d/%d", v[0], rule->srcIO, rule->cond, rule->threshold, rule->dstIO, rule->action, rule->param);
+    } else {
+        MIO_LOG_WARN("DL rule not set as wrong length %d", l);
+    }
+}
+
+// Check rules using this io as source after its value changed (isEvent : button/state callback) or was read, and do the action of those that just became true
+static void evaluateRules(int ioid, bool isEvent) {
+    int32_t v = _ctx.ios[ioid].measure;
+    for(int r=0;r<NB_RULES;r++) {
+        struct miorule* rule = &_ctx.rules[r];
+        if (rule->srcIO!=ioid) {
+            continue;
+        }
+        bool fire = false;
+        switch(rule->cond) {
+            case RULE_GT:
+            case RULE_LT:
+            case RULE_EQ: {
+                bool c = (rule->cond==RULE_GT)?(v > rule->threshold):((rule->cond==RULE_LT)?(v < rule->threshold):(v == rule->threshold));
+                fire = (c && !rule->condTrue);
+                rule->condTrue = c;
+                break;
+            }
+            case RULE_CHANGE: {
+                fire = isEvent || (rule->primed && v!=rule->lastValue);
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+        rule->lastValue = v;
+        rule->primed = true;
+        if (!fire) {
+            continue;
+        }
+        int dst = rule->dstIO;
+        if (!isOut(_ctx.ios[dst].type)) {
+            MIO_LOG_WARN("MIO:rule %d dst io %d is not an output", r, dst);
+            continue;
+        }
+        switch(rule->action) {
+            case RULE_ACT_SET: {
+                // cancels any timed operation, even if the output already has the value
+                os_callout_stop(&_ctx.ios[dst].timer);
+                if (_ctx.ios[dst].valueDL!=(uint8_t)rule->param) {
+                    _ctx.ios[dst].valueDL = (uint8_t)rule->param;
+                    writeIO(dst);
+                }
+                break;
+            }
+            case RULE_ACT_TOGGLE: {
+                os_callout_stop(&_ctx.ios[dst].timer);
+                _ctx.ios[dst].valueDL = !(_ctx.ios[dst].valueDL);
+                writeIO(dst);
+                break;
+            }
+            case RULE_ACT_PULSE: {
+                startTimedIO(dst, TIMED_PULSE_MS, 1, rule->param);
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+        MIO_LOG_INFO("MIO:rule %d on io %d value %d sets io %d[%s] to %d", r, ioid, v, dst, _ctx.ios[dst].name, _ctx.ios[dst].valueDL);
+    }
+}
+
+// ios that have a full resolution value worth sending and aggregating
+static bool hasMeasure(IO_TYPE t) {
+    return (t==IO_AIN || t==IO_DS18B20 || t==IO_FREQ || t==IO_USDIST_TRIG);
+}
+
+// Aggregate the latest measure of an io until the next UL : O(1) whatever the number of samples
+static void addSample(int ioid) {
+    struct mio* io = &_ctx.ios[ioid];
+    if (io->aggCount==0) {
+        io->aggMin = io->measure;
+        io->aggMax = io->measure;
+        io->aggSum = 0;
+    } else {
+        if (io->measure<io->aggMin) {
+            io->aggMin = io->measure;
+        }
+        if (io->measure>io->aggMax) {
+            io->aggMax = io->measure;
+        }
+    }
+    io->aggLast = io->measure;
+    // the mean is of the first 65535 samples : the sum stops with the count
+    if (io->aggCount<0xFFFF) {
+        io->aggSum += io->measure;
+        io->aggCount++;
+    }
+}
+
+static void putI16(uint8_t* b, int32_t v) {
+    if (v>INT16_MAX) {
+        v = INT16_MAX;
+    } else if (v<INT16_MIN) {
+        v = INT16_MIN;
+    }
+    b[0] = v & 0xFF;
+    b[1] = (v >> 8) & 0xFF;
+}
+
+// Full resolution values of the measuring ios since the last UL, and reset the aggregation
+static void addMeasuresUL(APP_CORE_UL_t* ul) {
+    /* structure equiv, per io with a measure:
+     * uint8_t bit 7 : set if aggregated from several samples, bits 2-0 : io id
+     * if aggregated:
+     *   uint8_t number of samples (saturates at 255)
+     *   int16_t min, max, mean (LSB first)
+     * int16_t last value (LSB first)
+     */
+    uint8_t ms[NB_IOS*10];
+    int len = 0;
+    uint8_t sent = 0;       // mask of the ios in the TLV
+    for(int i=0;i<NB_IOS;i++) {
+        struct mio* io = &_ctx.ios[i];
+        if (io->gpio<0 || !hasMeasure(io->type) || io->aggCount==0) {
+            continue;
+        }
+        // a single read at UL time is only sent if asked for, the IO status TLV already has its value
+        if (io->aggCount==1 && !MYNEWT_VAL(MIO_UL_MEASURES_SINGLE)) {
+            io->aggCount = 0;
+            continue;
+        }
+        if (io->aggCount>1) {
+            ms[len++] = 0x80 | i;
+            ms[len++] = (io->aggCount>0xFF)?0xFF:io->aggCount;
+            putI16(&ms[len], io->aggMin);
+            putI16(&ms[len+2], io->aggMax);
+            putI16(&ms[len+4], (int32_t)(io->aggSum/io->aggCount));
+            len += 6;
+        } else {
+            ms[len++] = i;
+        }
+        putI16(&ms[len], io->aggLast);
+        len += 2;
+        MIO_LOG_INFO("MIO: io %d %d samples min %d max %d last %d", i, io->aggCount, io->aggMin, io->aggMax, io->aggLast);
+        sent |= (1<<i);
+    }
+    // optional : if the UL is full the samples go on being aggregated for the next one
+    if (len>0 && fitsUL(len) && addTLV(ul, UL_APP_IO_MEASURES, len, &ms[0])) {
+        for(int i=0;i<NB_IOS;i++) {
+            if (sent & (1<<i)) {
+                _ctx.ios[i].aggCount = 0;
+            }
+        }
+    }
+}
+
+// Sample an io between ULs
+static void sampleTimeout(struct os_event* e) {
+    int ioid = (int)(e->ev_arg);
+    if (ioid>=0 && ioid<NB_IOS && _ctx.ios[ioid].samplePeriodMS>0) {
+        uint32_t nextMS = _ctx.ios[ioid].samplePeriodMS;
+        if (_ctx.ios[ioid].sampleStarted) {
+            // warmup over, read it and keep the sampling period
+            _ctx.ios[ioid].sampleStarted = false;
+            nextMS -= _ctx.ios[ioid].warmupMS;
         } else {
-            log_warn("MIO:input state change but bad id %d", ctx);
+            // sensors that need it are started, and read when their warmup is over
+            uint32_t warmupMS = startIO(ioid);
+            if (warmupMS>0 && warmupMS<nextMS) {
+                _ctx.ios[ioid].sampleStarted = true;
+                os_callout_reset(&_ctx.ios[ioid].sampleTimer, os_time_ms_to_ticks32(warmupMS));
+                return;
+            }
+        }
+        readIO(ioid);
+        os_callout_reset(&_ctx.ios[ioid].sampleTimer, os_time_ms_to_ticks32(nextMS));
+    }
+}
+
+#if MYNEWT_VAL(MIO_ADC_SCAN)
+// Convert all the AIN ios in 1 DMA scan, results go in their measure
+static void scanAINs() {
+    uint8_t chans[ADCSCAN_MAX_CHANNELS];
+    uint8_t ioids[ADCSCAN_MAX_CHANNELS];
+    uint16_t res[ADCSCAN_MAX_CHANNELS];
+    int nb = 0;
+    for(int i=0;i<NB_IOS && nb<ADCSCAN_MAX_CHANNELS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==IO_AIN) {
+            int c = adcscan_gpioToChannel(_ctx.ios[i].gpio);
+            if (c>=0) {
+                chans[nb] = c;
+                ioids[nb] = i;
+                nb++;
+            }
         }
+    }
+    if (nb==0) {
+        return;
+    }
+    bool ok;
+    AWAKE_TIMED(AWAKE_ADC, ok = adcscan_read(chans, nb, res));
+    if (ok) {
+        for(int j=0;j<nb;j++) {
+            struct mio* io = &_ctx.ios[ioids[j]];
+#if MYNEWT_VAL(MIO_ADC_CALIBRATE)
+            // results in mV whatever the battery level, convert to the io's unit
+            io->measure = (((int32_t)res[j] * io->scaleMul) / io->scaleDiv) + io->scaleOffset;
+#else
+            io->measure = res[j];
+#endif
+        }
+#if MYNEWT_VAL(MIO_ADC_CALIBRATE)
+        MIO_LOG_DEBUG("MIO:ADC scan VDDA %d mV MCU temp %d", adcscan_getVDDA(), adcscan_getMCUTemp());
+#endif
     } else {
-        log_info("MIO:input state change ignore not active");
+        MIO_LOG_WARN("MIO:ADC scan failed");
+    }
+}
+#endif /* MYNEWT_VAL(MIO_ADC_SCAN) */
+
+// Pulse counts : total and since the last UL
+static void addCountersUL(APP_CORE_UL_t* ul) {
+    /* structure equiv, per IO_COUNTER io:
+     * uint8_t io id
+     * uint32_t total count (LSB first)
+     * uint16_t count since last UL (LSB first), saturates at 65535
+     */
+    uint8_t cs[NB_IOS*7];
+    int len = 0;
+    for(int i=0;i<NB_IOS;i++) {
+        struct mio* io = &_ctx.ios[i];
+        if (io->gpio<0 || io->type!=IO_COUNTER) {
+            continue;
+        }
+        uint32_t delta = io->count - io->countAtUL;
+        if (delta>0xFFFF) {
+            delta = 0xFFFF;
+        }
+        cs[len++] = i;
+        cs[len++] = io->count & 0xFF;
+        cs[len++] = (io->count >> 8) & 0xFF;
+        cs[len++] = (io->count >> 16) & 0xFF;
+        cs[len++] = (io->count >> 24) & 0xFF;
+        cs[len++] = delta & 0xFF;
+        cs[len++] = (delta >> 8) & 0xFF;
+        MIO_LOG_INFO("MIO: io %d count %d delta %d", i, io->count, delta);
+    }
+    // optional : if the UL is full the deltas are sent by the next one
+    if (len>0 && fitsUL(len) && addTLV(ul, UL_APP_IO_COUNTERS, len, &cs[0])) {
+        for(int i=0;i<NB_IOS;i++) {
+            if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==IO_COUNTER) {
+                _ctx.ios[i].countAtUL = _ctx.ios[i].count;
+            }
+        }
+    }
+}
+
+// Awake time per activity since boot, every MIO_AWAKE_UL_PERIOD ULs or when asked by DL
+static void addAwakeUL(APP_CORE_UL_t* ul) {
+#if MYNEWT_VAL(MIO_AWAKE_ACCOUNTING)
+    /* structure equiv:
+     * uint8_t number of activities n
+     * uint32_t[n] time in ms per activity (LSB first)
+     * uint32_t estimated charge in uAh (LSB first)
+     */
+#if MYNEWT_VAL(MIO_AWAKE_UL_PERIOD)>0
+    if (++_ctx.nbULsSinceAwake >= MYNEWT_VAL(MIO_AWAKE_UL_PERIOD)) {
+        _ctx.nbULsSinceAwake = 0;
+        _ctx.awakeULPending = true;
+    }
+#endif
+    // optional : stays pending until a UL has room for it
+    if (!_ctx.awakeULPending || !fitsUL(1+(AWAKE_NB+1)*4)) {
+        return;
+    }
+    uint8_t as[1+(AWAKE_NB+1)*4];
+    int len = 0;
+    as[len++] = AWAKE_NB;
+    for(int i=0;i<=AWAKE_NB;i++) {
+        uint32_t v = (i<AWAKE_NB) ? (uint32_t)(awake_getUS(i)/1000) : awake_getChargeUAH();
+        as[len++] = v & 0xFF;
+        as[len++] = (v >> 8) & 0xFF;
+        as[len++] = (v >> 16) & 0xFF;
+        as[len++] = (v >> 24) & 0xFF;
+    }
+    if (addTLV(ul, UL_APP_IO_AWAKE, len, &as[0])) {
+        _ctx.awakeULPending = false;
+    }
+#endif
+}
+
+#if MYNEWT_VAL(MIO_AWAKE_ACCOUNTING)
+// DL action asking for the awake time TLV in the next UL, no parameters
+static void ioawakeAction(uint8_t* v, uint8_t l) {
+    mio_trace_dl(DL_APP_IO_AWAKE, v, l);
+    _ctx.awakeULPending = true;
+}
+#endif
+
+// add a TLV to the UL, and to the trace of the UL
+static bool addTLV(APP_CORE_UL_t* ul, uint8_t t, uint8_t l, void* v) {
+    if (!app_core_msg_ul_addTLV(ul, t, l, v)) {
+        MIO_LOG_WARN("MIO:UL full, TLV %d (%d bytes) not sent", t, l);
+        return false;
+    }
+    mio_trace_ulTLV(t, l, v);
+    _ctx.ulBytes += 2+l;
+    return true;
+}
+
+// true if a TLV with l bytes of value stays within MIO_UL_MAX_BYTES : the optional TLVs are only added if so
+static bool fitsUL(uint8_t l) {
+    if (_ctx.ulBytes+2+l > MYNEWT_VAL(MIO_UL_MAX_BYTES)) {
+        MIO_LOG_DEBUG("MIO:no room in UL for %d bytes (%d used)", l, _ctx.ulBytes);
+        return false;
+    }
+    return true;
+}
+
+static hal_gpio_pull_t halPull(GPIO_IDLE_TYPE p) {
+    return (p==PULL_UP)?HAL_GPIO_PULL_UP:((p==PULL_DOWN)?HAL_GPIO_PULL_DOWN:HAL_GPIO_PULL_NONE);
+}
+
+// First active io of the given type, -1 if none
+static int findIO(IO_TYPE t) {
+    for(int i=0;i<NB_IOS;i++) {
+        if (_ctx.ios[i].gpio>=0 && _ctx.ios[i].type==t) {
+            return i;
+        }
     }
+    return -1;
 }
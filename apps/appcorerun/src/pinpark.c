@@ -0,0 +1,187 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Low power parking of pins for the STM32L1 : in analog mode a pin has no input buffer, pull or drive, so it can't leak through 
+ * an external circuit or a floating input. Only the unused pins are parked, the others belong to the GPIO manager or to a driver 
+ * that sets them for low power itself. The ADC is also switched off if it was left on, and back on at restore.
+ */
+#include "os/os.h"
+
+#include "wyres-generic/wutils.h"
+
+#include "pinpark.h"
+#include "mio_log.h"
+
+#if MYNEWT_VAL(MIO_PIN_PARKING)
+
+#include "stm32l1xx_hal.h"
+
+#define PORT_PINS (16)
+#define NB_PORTS (3)
+#define MODE_INPUT (0x0)
+#define MODE_OUTPUT (0x1)
+#define MODE_ANALOG (0x3)
+#define PULL_NONE (0x0)
+#define PULL_UP (0x1)
+
+static struct parked {
+    int8_t gpio;            // -1 if slot free
+    bool parked;
+} _pins[PINPARK_MAX] = {
+    [0 ... (PINPARK_MAX-1)] = { .gpio = -1 },
+};
+static bool _adcWasOn = false;
+static bool _adcClkWasOn = false;
+static bool _parked = false;
+
+static GPIO_TypeDef* port(int8_t gpio) {
+    switch(gpio/PORT_PINS) {
+        case 0: return GPIOA;
+        case 1: return GPIOB;
+        case 2: return GPIOC;
+        default: return NULL;
+    }
+}
+
+bool pinpark_define(int8_t gpio) {
+    if (gpio<0 || port(gpio)==NULL) {
+        return false;
+    }
+    int free = -1;
+    for(int i=0;i<PINPARK_MAX;i++) {
+        if (_pins[i].gpio==gpio) {
+            return true;        // already there
+        }
+        if (_pins[i].gpio<0 && free<0) {
+            free = i;
+        }
+    }
+    if (free<0) {
+        return false;
+    }
+    _pins[free].gpio = gpio;
+    _pins[free].parked = false;
+    return true;
+}
+
+void pinpark_idle(int8_t gpio, hal_gpio_pull_t pull) {
+    if (gpio<0 || port(gpio)==NULL) {
+        return;
+    }
+    GPIO_TypeDef* p = port(gpio);
+    int pin = gpio % PORT_PINS;
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    p->PUPDR &= ~(0x3u << (pin*2));
+    p->MODER |= (MODE_ANALOG << (pin*2));
+    OS_EXIT_CRITICAL(sr);
+}
+
+void pinpark_parkAll() {
+    if (_parked) {
+        return;         // keep the ADC state saved by the first park
+    }
+    _parked = true;
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for(int i=0;i<PINPARK_MAX;i++) {
+        if (_pins[i].gpio>=0 && !_pins[i].parked) {
+            GPIO_TypeDef* p = port(_pins[i].gpio);
+            int pin = _pins[i].gpio % PORT_PINS;
+            p->PUPDR &= ~(0x3u << (pin*2));
+            p->MODER |= (MODE_ANALOG << (pin*2));
+            _pins[i].parked = true;
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+    // The ADC draws current when on, even if not converting
+    _adcClkWasOn = ((RCC->APB2ENR & RCC_APB2ENR_ADC1EN)!=0);
+    _adcWasOn = _adcClkWasOn && ((ADC1->CR2 & ADC_CR2_ADON)!=0);
+    if (_adcWasOn) {
+        ADC1->CR2 &= ~ADC_CR2_ADON;
+    }
+    if (_adcClkWasOn) {
+        RCC->APB2ENR &= ~RCC_APB2ENR_ADC1EN;
+    }
+}
+
+void pinpark_restoreAll() {
+    if (!_parked) {
+        return;
+    }
+    _parked = false;
+    // the unused pins stay parked
+    if (_adcClkWasOn) {
+        RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+    }
+    if (_adcWasOn) {
+        ADC1->CR2 |= ADC_CR2_ADON;
+    }
+    _adcWasOn = false;
+    _adcClkWasOn = false;
+}
+
+void pinpark_report() {
+    static const char portName[NB_PORTS] = { 'A', 'B', 'C' };
+    int nbFloating = 0;
+    int nbPullFight = 0;
+    for(int pi=0;pi<NB_PORTS;pi++) {
+        GPIO_TypeDef* p = port(pi*PORT_PINS);
+        MIO_LOG_INFO("LP:P%c MODER %08x PUPDR %08x ODR %04x IDR %04x", portName[pi], p->MODER, p->PUPDR, p->ODR & 0xFFFF, p->IDR & 0xFFFF);
+        for(int pin=0;pin<PORT_PINS;pin++) {
+            uint32_t mode = (p->MODER >> (pin*2)) & 0x3;
+            uint32_t pull = (p->PUPDR >> (pin*2)) & 0x3;
+            uint32_t level = (p->IDR >> pin) & 0x1;
+            if (mode!=MODE_INPUT) {
+                continue;
+            }
+            // a floating input leaks if the level sits between the thresholds, a pull leaks if something drives against it
+            if (pull==PULL_NONE) {
+                MIO_LOG_INFO("LP:P%c%d floating input (%d)", portName[pi], pin, level);
+                nbFloating++;
+            } else if ((pull==PULL_UP)!=(level==1)) {
+                MIO_LOG_INFO("LP:P%c%d input pulled %s but reads %d", portName[pi], pin, (pull==PULL_UP)?"up":"down", level);
+                nbPullFight++;
+            }
+        }
+    }
+    int nbParked = 0;
+    for(int i=0;i<PINPARK_MAX;i++) {
+        if (_pins[i].gpio>=0 && _pins[i].parked) {
+            nbParked++;
+        }
+    }
+    MIO_LOG_INFO("LP:%d pins parked, %d floating inputs, %d pulls driven against, ADC %s HSI %s", nbParked, nbFloating, nbPullFight, 
+        ((RCC->APB2ENR & RCC_APB2ENR_ADC1EN) && (ADC1->CR2 & ADC_CR2_ADON))?"on":"off", 
+        (RCC->CR & RCC_CR_HSION)?"on":"off");
+}
+
+#else /* MYNEWT_VAL(MIO_PIN_PARKING) */
+
+// Parking not enabled for this target : pins are left as their drivers set them
+bool pinpark_define(int8_t gpio) {
+    return false;
+}
+void pinpark_idle(int8_t gpio, hal_gpio_pull_t pull) {
+    if (gpio>=0) {
+        hal_gpio_init_in(gpio, pull);
+    }
+}
+void pinpark_parkAll() {
+}
+void pinpark_restoreAll() {
+}
+void pinpark_report() {
+}
+
+#endif /* MYNEWT_VAL(MIO_PIN_PARKING) */
@@ -0,0 +1,145 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Pulse inputs handled by EXTI interrupt, so nothing runs between edges and the MCU can stay in low power (the EXTI wakes it).
+ * Frequency is measured by reciprocal counting : the time between the first and last edges seen during the gate, divided by the 
+ * number of periods, using the cputime timer. This gives the resolution of the timer whatever the frequency, with no polling. 
+ * Its for the low frequencies of field sensors (up to some kHz), as each edge is an interrupt.
+ */
+#include "os/os.h"
+#include <hal/hal_gpio.h>
+
+#include "pulsein.h"
+
+// Note not using gpiomgr as the pin must stay an active interrupt input in low power
+
+static struct pulsein {
+    int8_t gpio;                // -1 if not used
+    volatile uint32_t count;
+    uint32_t debounceTicks;     // in cputime ticks, 0 for no debounce
+    uint32_t lastEdgeTS;        // cputime of last counted edge
+    // frequency measurement
+    struct os_callout gate;
+    volatile bool gateOpen;
+    uint32_t firstEdgeTS;
+    uint32_t periodUS;          // result of last gate
+    PULSEIN_DONE_CB_t doneCB;   // called when the gate closes
+} _pins[PULSEIN_MAX] = {
+    [0 ... (PULSEIN_MAX-1)] = { .gpio = -1 },
+};
+
+// Interrupt on each edge : keep it short
+static void counterIRQ(void* arg) {
+    struct pulsein* p = (struct pulsein*)arg;
+    if (p->debounceTicks>0) {
+        uint32_t now = os_cputime_get32();
+        if ((now - p->lastEdgeTS) < p->debounceTicks) {
+            return;
+        }
+        p->lastEdgeTS = now;
+    }
+    p->count++;
+}
+
+bool pulsein_defineCounter(int id, int8_t gpio, hal_gpio_pull_t pull, uint32_t debounceMS) {
+    if (id<0 || id>=PULSEIN_MAX || gpio<0) {
+        return false;
+    }
+    struct pulsein* p = &_pins[id];
+    p->gpio = gpio;
+    p->count = 0;
+    p->debounceTicks = os_cputime_usecs_to_ticks(debounceMS*1000);
+    p->lastEdgeTS = os_cputime_get32() - p->debounceTicks;
+    if (hal_gpio_irq_init(gpio, counterIRQ, p, HAL_GPIO_TRIG_FALLING, pull)!=0) {
+        p->gpio = -1;
+        return false;
+    }
+    hal_gpio_irq_enable(gpio);
+    return true;
+}
+
+uint32_t pulsein_getCount(int id) {
+    if (id<0 || id>=PULSEIN_MAX || _pins[id].gpio<0) {
+        return 0;
+    }
+    return _pins[id].count;
+}
+
+// Timestamp edges during the gate
+static void freqIRQ(void* arg) {
+    struct pulsein* p = (struct pulsein*)arg;
+    if (!p->gateOpen) {
+        return;
+    }
+    uint32_t now = os_cputime_get32();
+    if (p->count==0) {
+        p->firstEdgeTS = now;
+    }
+    p->lastEdgeTS = now;
+    p->count++;
+}
+
+static void gateClose(struct os_event* e) {
+    struct pulsein* p = (struct pulsein*)(e->ev_arg);
+    hal_gpio_irq_disable(p->gpio);
+    p->gateOpen = false;
+    if (p->count>=2) {
+        p->periodUS = os_cputime_ticks_to_usecs(p->lastEdgeTS - p->firstEdgeTS) / (p->count-1);
+    } else {
+        p->periodUS = 0;
+    }
+    if (p->doneCB!=NULL) {
+        (*p->doneCB)(p - &_pins[0]);
+    }
+}
+
+bool pulsein_defineFreq(int id, int8_t gpio, hal_gpio_pull_t pull) {
+    if (id<0 || id>=PULSEIN_MAX || gpio<0) {
+        return false;
+    }
+    struct pulsein* p = &_pins[id];
+    p->gpio = gpio;
+    p->gateOpen = false;
+    p->periodUS = 0;
+    os_callout_init(&p->gate, os_eventq_dflt_get(), gateClose, p);
+    if (hal_gpio_irq_init(gpio, freqIRQ, p, HAL_GPIO_TRIG_FALLING, pull)!=0) {
+        p->gpio = -1;
+        return false;
+    }
+    // only enabled during a gate
+    hal_gpio_irq_disable(gpio);
+    return true;
+}
+
+bool pulsein_startFreq(int id, uint32_t gateMS, PULSEIN_DONE_CB_t doneCB) {
+    if (id<0 || id>=PULSEIN_MAX || _pins[id].gpio<0) {
+        return false;
+    }
+    struct pulsein* p = &_pins[id];
+    if (p->gateOpen) {
+        return false;     // already measuring, for someone else
+    }
+    p->count = 0;
+    p->doneCB = doneCB;
+    p->gateOpen = true;
+    hal_gpio_irq_enable(p->gpio);
+    os_callout_reset(&p->gate, os_time_ms_to_ticks32(gateMS));
+    return true;
+}
+
+uint32_t pulsein_getPeriodUS(int id) {
+    if (id<0 || id>=PULSEIN_MAX || _pins[id].gpio<0) {
+        return 0;
+    }
+    return _pins[id].periodUS;
+}
@@ -0,0 +1,202 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Ultrasonic distance measurement. The trigger pulse is ended by a one shot cputime timer, and the echo pulse is timed by 
+ * interrupts on both its edges against the same timer, so the cpu is not busy waiting during the ping.
+ * The burst runs in the background on the default event queue : each ping ends with its echo (event posted by the interrupt) 
+ * or its timeout, and the next one is started after the gap.
+ */
+#include "os/os.h"
+#include <hal/hal_gpio.h>
+
+#include "usdist.h"
+#include "awake.h"
+
+#define TRIG_PULSE_US (10)
+// no echo pulse is longer than this (sensor gives up at ~38ms)
+#define PING_TIMEOUT_MS (40)
+// time between pings to let the previous echos die out
+#define PING_GAP_MS (20)
+#define MAX_PINGS (9)
+// valid echo times : 2.5cm to 4m
+#define ECHO_MIN_US (150)
+#define ECHO_MAX_US (23500)
+#define MAX_MS (MYNEWT_VAL(MIO_USDIST_MAX_MS))
+#define OUTLIER_PCT (MYNEWT_VAL(MIO_USDIST_OUTLIER_PCT))
+// speed of sound in 1/10 mm/ms : 331.3 + 0.606*T(degC)
+#define SOUND_0C_DMM_PER_MS (3313)
+#define SOUND_DMM_PER_MS_PER_DEGC_X100 (606)
+
+static struct {
+    int8_t trig;
+    int8_t echo;
+    hal_gpio_pull_t echoPull;
+    struct hal_timer trigTimer;
+    struct os_event echoEv;
+    struct os_callout pingTimer;    // end of ping timeout
+    struct os_callout gapTimer;     // start of next ping
+    bool init;
+    bool running;                   // burst in progress
+    bool pinging;                   // waiting for the echo of a ping
+    volatile uint32_t riseTS;
+    volatile uint32_t echoTicks;
+    int nbPings;
+    int nbPinged;
+    uint32_t startTS;
+    uint64_t pingUS;                // start of the current ping, for the awake time accounting
+    uint32_t busyUS;                // time the sensor spent pinging in this burst, without the gaps
+    // valid echos of the burst, sorted as we go (insertion)
+    uint32_t echos[MAX_PINGS];
+    int nbEchos;
+    uint32_t lastEchoUS;
+    USDIST_CB_t cb;
+    void* cbCtx;
+} _ctx = {
+    .init = false,
+    .running = false,
+};
+
+static void pingEnd(struct os_event* e);
+static void pingNext(struct os_event* e);
+
+// end of trigger pulse
+static void trigEnd(void* arg) {
+    hal_gpio_write(_ctx.trig, 0);
+}
+
+// echo edges
+static void echoIRQ(void* arg) {
+    int8_t echo = (int8_t)(int)arg;
+    uint32_t now = os_cputime_get32();
+    if (hal_gpio_read(echo)) {
+        _ctx.riseTS = now;
+    } else if (_ctx.riseTS!=0) {
+        _ctx.echoTicks = now - _ctx.riseTS;
+        os_eventq_put(os_eventq_dflt_get(), &_ctx.echoEv);
+    }
+}
+
+// Mean of the echos close to the median, others are outliers (multipath, noise). 0 if no valid echo
+static uint32_t filterEchos() {
+    if (_ctx.nbEchos==0) {
+        return 0;
+    }
+    uint32_t median = _ctx.echos[_ctx.nbEchos/2];
+    uint32_t maxDiff = (median*OUTLIER_PCT)/100;
+    uint32_t sum = 0;
+    int nb = 0;
+    for(int i=0;i<_ctx.nbEchos;i++) {
+        uint32_t diff = (_ctx.echos[i]>median)?(_ctx.echos[i]-median):(median-_ctx.echos[i]);
+        if (diff<=maxDiff) {
+            sum += _ctx.echos[i];
+            nb++;
+        }
+    }
+    return sum/nb;
+}
+
+// Start the next ping, or end the burst if done or out of time
+static void pingNext(struct os_event* e) {
+    if (_ctx.nbPinged>=_ctx.nbPings || 
+            os_time_ticks_to_ms32(os_time_get()-_ctx.startTS)+PING_TIMEOUT_MS > MAX_MS) {
+        hal_gpio_irq_release(_ctx.echo);
+        // restore as plain input
+        hal_gpio_init_in(_ctx.echo, _ctx.echoPull);
+        _ctx.lastEchoUS = filterEchos();
+        _ctx.running = false;
+        awake_add(AWAKE_USDIST, _ctx.busyUS);
+        if (_ctx.cb!=NULL) {
+            (*_ctx.cb)(_ctx.cbCtx, _ctx.lastEchoUS);
+        }
+        return;
+    }
+    _ctx.nbPinged++;
+    _ctx.riseTS = 0;
+    _ctx.echoTicks = 0;
+    _ctx.pinging = true;
+    _ctx.pingUS = awake_now();
+    hal_gpio_write(_ctx.trig, 1);
+    os_cputime_timer_relative(&_ctx.trigTimer, TRIG_PULSE_US);
+    os_callout_reset(&_ctx.pingTimer, os_time_ms_to_ticks32(PING_TIMEOUT_MS));
+}
+
+// Echo received or ping timeout : keep the echo if valid, and next ping after the gap
+static void pingEnd(struct os_event* e) {
+    if (!_ctx.pinging) {
+        return;         // late echo of a ping that already timed out
+    }
+    _ctx.pinging = false;
+    _ctx.busyUS += (uint32_t)(awake_now()-_ctx.pingUS);
+    os_callout_stop(&_ctx.pingTimer);
+    uint32_t echoUS = os_cputime_ticks_to_usecs(_ctx.echoTicks);
+    if (echoUS>=ECHO_MIN_US && echoUS<=ECHO_MAX_US) {
+        int j = _ctx.nbEchos;
+        while(j>0 && _ctx.echos[j-1]>echoUS) {
+            _ctx.echos[j] = _ctx.echos[j-1];
+            j--;
+        }
+        _ctx.echos[j] = echoUS;
+        _ctx.nbEchos++;
+    }
+    os_callout_reset(&_ctx.gapTimer, os_time_ms_to_ticks32(PING_GAP_MS));
+}
+
+bool usdist_startMeasure(int8_t trig, int8_t echo, hal_gpio_pull_t echoPull, int nbPings, USDIST_CB_t cb, void* cbCtx) {
+    if (trig<0 || echo<0) {
+        return false;
+    }
+    if (!_ctx.init) {
+        os_cputime_timer_init(&_ctx.trigTimer, trigEnd, NULL);
+        _ctx.echoEv.ev_cb = pingEnd;
+        os_callout_init(&_ctx.pingTimer, os_eventq_dflt_get(), pingEnd, NULL);
+        os_callout_init(&_ctx.gapTimer, os_eventq_dflt_get(), pingNext, NULL);
+        _ctx.init = true;
+    }
+    if (_ctx.running) {
+        return false;       // 1 burst at a time
+    }
+    if (nbPings>MAX_PINGS) {
+        nbPings = MAX_PINGS;
+    }
+    _ctx.trig = trig;
+    _ctx.echo = echo;
+    _ctx.echoPull = echoPull;
+    _ctx.nbPings = nbPings;
+    _ctx.nbPinged = 0;
+    _ctx.nbEchos = 0;
+    _ctx.pinging = false;
+    _ctx.cb = cb;
+    _ctx.cbCtx = cbCtx;
+    _ctx.startTS = os_time_get();
+    _ctx.running = true;
+    _ctx.busyUS = 0;
+    hal_gpio_irq_init(echo, echoIRQ, (void*)(int)echo, HAL_GPIO_TRIG_BOTH, echoPull);
+    hal_gpio_irq_enable(echo);
+    // first ping straight away
+    pingNext(NULL);
+    return true;
+}
+
+uint32_t usdist_getEchoUS() {
+    return _ctx.lastEchoUS;
+}
+
+uint32_t usdist_echoToMM(uint32_t echoUS, int32_t temp16) {
+    // speed in 1/10 mm/ms at this temperature (1/16 degC)
+    int32_t c = SOUND_0C_DMM_PER_MS + ((temp16 * SOUND_DMM_PER_MS_PER_DEGC_X100) / (16*100));
+    if (c<=0) {
+        return 0;
+    }
+    // there and back : mm = us * (c/10) / 1000 / 2
+    return (echoUS * (uint32_t)c) / 20000;
+}
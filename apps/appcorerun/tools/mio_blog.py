@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# Expands the mod-io binary log (MIO_BINARY_LOG) : reads the 'BL:' hex lines from a console capture (file or stdin) and
+# rebuilds each log line from its format string in the elf of the build that produced it.
+# usage : mio_blog.py <app.elf> [capture.txt]
+import re
+import struct
+import sys
+
+LEVELS = ['DBG', 'INF', 'WRN', 'ERR']
+FMT_RE = re.compile(r'%[-+ 0#]*\d*(?:\.\d+)?(?:hh|h|ll|l|z)?([diuxXcsp%])')
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+class Elf:
+    """ the loaded sections of a 32 bits little endian elf, to read constant strings by address """
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1:
+            raise ValueError('%s is not a 32 bits elf' % path)
+        shoff, = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2e)
+        self.sections = []
+        for i in range(shnum):
+            _, stype, flags, addr, offset, size = struct.unpack_from('<IIIIII', self.data, shoff + i*shentsize)
+            if (flags & SHF_ALLOC) and stype != SHT_NOBITS and size > 0:
+                self.sections.append((addr, offset, size))
+
+    def string(self, addr):
+        for saddr, offset, size in self.sections:
+            if saddr <= addr < saddr + size:
+                start = offset + addr - saddr
+                end = self.data.index(b'\0', start)
+                return self.data[start:end].decode('ascii', 'replace')
+        return None
+
+def signed(v):
+    return v - (1 << 32) if v & 0x80000000 else v
+
+def expand(elf, fmt, args):
+    args = list(args)
+    def conv(m):
+        spec = m.group(0)
+        c = m.group(1)
+        if c == '%':
+            return '%'
+        if not args:
+            return '<?>'
+        v = args.pop(0)
+        spec = re.sub(r'(hh|h|ll|l|z)', '', spec)
+        if c in 'di':
+            return spec % signed(v)
+        if c in 'uxX':
+            return (spec[:-1] + ('d' if c == 'u' else c)) % v
+        if c == 'c':
+            return chr(v & 0xff)
+        if c == 's':
+            s = elf.string(v)
+            return (spec % s) if s is not None else '<0x%08x>' % v
+        return '0x%08x' % v
+    return FMT_RE.sub(conv, fmt)
+
+def records(lines):
+    """ yields (format address, time ms, level, args) from the hex words of the BL: lines """
+    for line in lines:
+        m = re.search(r'BL:([0-9a-fA-F]+)', line)
+        if not m:
+            if 'BL:lost' in line:
+                print(line.strip())
+            continue
+        hexs = m.group(1)
+        words = [int(hexs[i:i+8], 16) for i in range(0, len(hexs) - 7, 8)]
+        i = 0
+        while i + 1 < len(words):
+            hdr = words[i+1]
+            n = hdr & 0xf
+            yield words[i], hdr >> 8, (hdr >> 4) & 0x3, words[i+2:i+2+n]
+            i += 2 + n
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage : mio_blog.py <app.elf> [capture.txt]')
+        sys.exit(1)
+    elf = Elf(sys.argv[1])
+    inp = open(sys.argv[2]) if len(sys.argv) > 2 else sys.stdin
+    # the time is 24 bits of ms in the records, and a time record (format address 0) gives the full 32 bits each time the upper
+    # bits change. Until the first one (capture started mid-way) the 24 bits are unwrapped as they go.
+    high = 0
+    synced = False
+    last = 0
+    for addr, ms, lvl, args in records(inp):
+        if addr == 0 and args:
+            if synced and args[0] < last:
+                # the 32 bits ms time wrapped (49.7 days)
+                high += 1 << 8
+            high = (high & ~0xff) | (args[0] >> 24)
+            last = args[0]
+            synced = True
+            continue
+        if not synced and ms < last:
+            high += 1
+        if not synced:
+            last = ms
+        fmt = elf.string(addr)
+        text = expand(elf, fmt, args) if fmt is not None else '<unknown format 0x%08x> %s' % (addr, ' '.join('%08x' % a for a in args))
+        print('%10d %s %s' % (ms + (high << 24), LEVELS[lvl], text))
+
+if __name__ == '__main__':
+    main()
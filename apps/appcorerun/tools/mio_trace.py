@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+# Decodes the mod-io field trace (MIO_TRACE) : reads the 'TR:' hex lines from a console capture (file or stdin) and prints the 
+# records. With the target of the device, writes them as a sim scenario script (-s) and/or replays them in the sim build of the 
+# target (--replay), comparing the ULs and their time on air in the field with the ones of the replay.
+# usage : mio_trace.py [-t target] [-s replay.sim] [--replay] [capture.txt]
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+SIM = os.path.join(ROOT, 'sim')
+sys.path.insert(0, SIM)
+import gensyscfg
+
+TR_START, TR_BUTTON, TR_STATE, TR_SAMPLE, TR_NOSAMPLE, TR_DL, TR_UL = range(7)
+TYPES = ['start', 'button', 'state', 'sample', 'nosample', 'dl', 'ul']
+PRESSES = ['', 'short', 'med', 'long', 'vlong']
+SR_BUTTON_PRESSED = 1
+# MHDR, FHDR without options, FPort and MIC around the app payload (as sim/src/appcore_sim.c)
+LORAWAN_OVERHEAD = 13
+
+def varint(b, i):
+    v = 0
+    shift = 0
+    while True:
+        c = b[i]
+        i += 1
+        v |= (c & 0x7f) << shift
+        shift += 7
+        if not c & 0x80:
+            return v, i
+
+def records(lines):
+    """ yields (time ms since boot, type, io id, data) from the hex bytes of the TR: lines """
+    hexs = ''
+    for line in lines:
+        m = re.search(r'TR:([0-9a-fA-F]+)\s*$', line)
+        if m:
+            hexs += m.group(1)
+        elif 'TR:lost' in line:
+            print('# ' + line.strip()[line.find('TR:'):], file=sys.stderr)
+    b = bytes.fromhex(hexs[:len(hexs) & ~1])
+    i = 0
+    now = 0
+    base = 0
+    try:
+        while i < len(b):
+            typ = b[i] >> 4
+            ioid = b[i] & 0x0f
+            dt, i = varint(b, i + 1)
+            if typ == TR_START:
+                # after a reboot, carry on from the last time
+                base = now
+                now = base + dt
+                yield now, typ, ioid, None
+                continue
+            now += dt
+            if typ in (TR_BUTTON, TR_STATE):
+                d = (b[i] & 0x0f, b[i] >> 4)
+                i += 1
+            elif typ == TR_SAMPLE:
+                z, i = varint(b, i)
+                d = (z >> 1) ^ -(z & 1)
+            elif typ == TR_NOSAMPLE:
+                d = None
+            elif typ == TR_DL:
+                d = (b[i], b[i+2:i+2+b[i+1]])
+                i += 2 + b[i+1]
+            elif typ == TR_UL:
+                d = (b[i], b[i+2:i+2+b[i+1]])
+                i += 2 + b[i+1]
+            else:
+                print('# bad record type %d at byte %d, rest ignored' % (typ, i), file=sys.stderr)
+                return
+            yield now, typ, ioid, d
+    except IndexError:
+        print('# trace ends in the middle of a record', file=sys.stderr)
+
+def describe(typ, ioid, d):
+    if typ == TR_START:
+        return 'start'
+    if typ in (TR_BUTTON, TR_STATE):
+        s = '%s io %d %s' % (TYPES[typ], ioid, 'pressed' if d[0] == SR_BUTTON_PRESSED else 'released')
+        return s + (' ' + PRESSES[d[1]] if typ == TR_BUTTON and 0 < d[1] < len(PRESSES) else '')
+    if typ == TR_SAMPLE:
+        return 'sample io %d %d' % (ioid, d)
+    if typ == TR_NOSAMPLE:
+        return 'sample io %d none' % ioid
+    if typ == TR_DL:
+        return 'dl %d %s' % (d[0], d[1].hex())
+    return 'ul %d bytes %s' % (d[0], d[1].hex())
+
+def syscfg(target):
+    """ the syscfg values of the sim build of the target, as sim/Makefile generates them """
+    defs = {}
+    vals = {}
+    for path in (os.path.join(ROOT, 'apps', 'appcorerun', 'syscfg.yml'), os.path.join(ROOT, 'targets', target, 'syscfg.yml'), 
+                 os.path.join(SIM, 'syscfg.yml')):
+        gensyscfg.parse(path, defs, vals)
+    defs.update(vals)
+    return defs
+
+def ios(cfg):
+    """ io id -> (pin name, io type) from the defineIO of the IO_n syscfgs """
+    res = {}
+    for k, v in cfg.items():
+        m = re.match(r'defineIO\(\s*(\d+)\s*,\s*(\w+)\s*,\s*"[^"]*"\s*,\s*(\w+)', v)
+        if k.startswith('IO_') and m:
+            res[int(m.group(1))] = (m.group(2), m.group(3))
+    return res
+
+def airtime_ms(sf, pl):
+    """ LoRa time on air (EU868, 125kHz, CR 4/5, explicit header, CRC on) as the sim computes it """
+    sym = (1 << sf) * 8 / 1000.0
+    de = 1 if sf >= 11 else 0
+    num = 8*pl - 4*sf + 28 + 16
+    den = 4*(sf - 2*de)
+    nb = 8 + (max(-(-num // den), 0) * 5 if num > 0 else 0)
+    return sym * (8 + 4.25) + nb * sym
+
+def script(recs, cfg):
+    """ the scenario lines replaying the inputs, the sensor values and the DLs at their field time """
+    io = ios(cfg)
+    echo = next((pin for pin, t in io.values() if t == 'IO_USDIST_INTR'), None)
+    asPeriod = cfg.get('MIO_FREQ_AS_PERIOD', '0') != '0'
+    lines = []
+    lastCount = {}
+    for t, typ, ioid, d in recs:
+        at = '%dms' % t
+        pin, iotype = io.get(ioid, (None, None))
+        if typ in (TR_BUTTON, TR_STATE) and pin:
+            # the inputs are active low
+            lines.append('%s in %s %d' % (at, pin, 0 if d[0] == SR_BUTTON_PRESSED else 1))
+        elif typ == TR_DL:
+            lines.append('%s dl %d %s' % (at, d[0], d[1].hex()))
+        elif typ in (TR_SAMPLE, TR_NOSAMPLE) and pin:
+            ok = (typ == TR_SAMPLE)
+            if iotype == 'IO_DIN' and ok:
+                lines.append('%s in %s %d' % (at, pin, d))
+            elif iotype == 'IO_AIN' and ok:
+                lines.append('%s adc %s %d' % (at, pin, d))
+            elif iotype == 'IO_DS18B20':
+                lines.append('%s temp %s %s' % (at, pin, ('%.4f' % (d / 16.0)) if ok else 'off'))
+            elif iotype == 'IO_USDIST_TRIG' and echo:
+                lines.append('%s dist %s %d' % (at, echo, d if ok else 0))
+            elif iotype == 'IO_FREQ' and ok:
+                hz = (1e6 / d if d > 0 else 0) if asPeriod else d / 10.0
+                lines.append('%s freq %s %.3f' % (at, pin, hz))
+            elif iotype == 'IO_COUNTER' and ok:
+                # pulses since the last UL, spread over the time since the previous reading
+                prev = lastCount.get(ioid, 0)
+                if d > 0:
+                    lines.append('%dms pulses %s %d %.3f' % (prev, pin, d, (t - prev) / (d + 1.0)))
+                lastCount[ioid] = t
+    return lines
+
+def report(recs, sf):
+    uls = [d for _, typ, _, d in recs if typ == TR_UL]
+    size = sum(d[0] for d in uls)
+    air = sum(airtime_ms(sf, d[0] + LORAWAN_OVERHEAD) for d in uls)
+    return len(uls), size, air
+
+def main():
+    ap = argparse.ArgumentParser(description='decode a mod-io field trace, and replay it in the sim')
+    ap.add_argument('-t', '--target', help='target of the device (in targets/), to map the io ids to pins')
+    ap.add_argument('-s', '--script', help='write the sim scenario script replaying the trace')
+    ap.add_argument('--replay', action='store_true', help='run the replay in the sim build of the target and compare with the field')
+    ap.add_argument('capture', nargs='?', help='console capture (stdin if none)')
+    args = ap.parse_args()
+    inp = open(args.capture) if args.capture else sys.stdin
+    recs = list(records(inp))
+    if not args.target:
+        if args.script or args.replay:
+            ap.error('the target is needed to replay')
+        for t, typ, ioid, d in recs:
+            print('%10d %s' % (t, describe(typ, ioid, d)))
+        return
+    cfg = syscfg(args.target)
+    lines = script(recs, cfg)
+    path = args.script
+    if path is None:
+        if not args.replay:
+            print('\n'.join(lines))
+            return
+        fd, path = tempfile.mkstemp(suffix='.sim')
+        os.close(fd)
+    with open(path, 'w') as f:
+        f.write('# replay of a mod-io field trace of %s\n' % args.target)
+        f.write('\n'.join(lines) + '\n')
+    if not args.replay:
+        return
+    # run until the last record, and the UL cycle it was in
+    end = (recs[-1][0] if recs else 0) + 60000
+    subprocess.run(['make', '-s', '-C', SIM, 'TARGET=' + args.target], check=True, stdout=subprocess.DEVNULL)
+    out = subprocess.run([os.path.join(SIM, 'build', args.target, 'appcorerun_sim'), '-x', '-q', '-s', path, '-d', '%dms' % end],
+                         check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    if not args.script:
+        os.remove(path)
+    sf = int(cfg.get('LORA_DEFAULT_SF', '9'))
+    nb, size, air = report(recs, sf)
+    sim = {}
+    for line in out.splitlines():
+        m = re.match(r'^(ULs|UL bytes|airtime)\s+([\d.]+)', line)
+        if m:
+            sim[m.group(1)] = float(m.group(2))
+    print('%-12s %10s %10s' % ('', 'field', 'replay'))
+    print('%-12s %10d %10d' % ('ULs', nb, sim.get('ULs', 0)))
+    print('%-12s %10d %10d' % ('UL bytes', size, sim.get('UL bytes', 0)))
+    print('%-12s %10.3f %10.3f' % ('airtime (s)', air / 1000.0, sim.get('airtime', 0)))
+
+if __name__ == '__main__':
+    main()
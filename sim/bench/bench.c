@@ -0,0 +1,265 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Host micro-benchmark of the mod-io encode/decode paths, on the sim build of a target (the app sources unchanged, main.c 
+ * replaced by this one). Each case is run N times and reports the host ns and cycles per op, the simulated device time per op 
+ * (bus timings and busy waits of the drivers) and the bytes produced (UL) or parsed (DL). Against a baseline, the host time is 
+ * flagged when more than SLOWER_PC % slower, and the device time and the bytes on any change (they don't depend on the host).
+ *   appcorerun_bench [-n iterations] [-s script] [-b baseline] [-w baseline]
+ *     -s : scenario script, its lines at time 0 set up the board (eg a DS18B20 on a pin)
+ *     -b : compare with a baseline written before by -w
+ *     -w : write the results as the new baseline
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "sysinit/sysinit.h"
+#include "app-core/app_core.h"
+#include "onewire.h"
+#include "DS18B20.h"
+#include "usdist.h"
+#include "sim.h"
+
+// the mod-io DL action ids, and its number of ios (see mod_io.c)
+#define DL_IO_SET (240)
+#define DL_IO_SETMASK (241)
+#define DL_IO_TIMED (242)
+#define NB_IOS (8)
+#define MAX_CASES (16)
+// slower than the baseline by more than this is flagged
+#define SLOWER_PC (10)
+
+typedef struct {
+    const char* name;
+    int bytes;              // produced or parsed by one op
+    double ns;
+    double cycles;
+    double simUS;
+} BENCH_RES_t;
+
+typedef int (*BENCH_FN_t)(int i);
+
+static struct {
+    APP_CORE_API_t* api;
+    int tempPin;
+    BENCH_RES_t res[MAX_CASES];
+    int nbRes;
+} _bench = {
+    .tempPin = -1,
+};
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static uint64_t nowNS() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000ULL + t.tv_nsec;
+}
+
+static void runCase(const char* name, BENCH_FN_t fn, int n) {
+    if (_bench.nbRes>=MAX_CASES) {
+        return;
+    }
+    // warm up, and the bytes of an op
+    int bytes = (*fn)(0);
+    uint64_t sim0 = sim_nowUS();
+    uint64_t c0 = cycles();
+    uint64_t t0 = nowNS();
+    for(int i=0;i<n;i++) {
+        (*fn)(i);
+    }
+    uint64_t t1 = nowNS();
+    uint64_t c1 = cycles();
+    BENCH_RES_t* r = &_bench.res[_bench.nbRes++];
+    r->name = name;
+    r->bytes = bytes;
+    r->ns = (double)(t1-t0)/n;
+    r->cycles = (double)(c1-c0)/n;
+    r->simUS = (double)(sim_nowUS()-sim0)/n;
+}
+
+static int benchGetData(int i) {
+    APP_CORE_UL_t ul;
+    ul.sz = 0;
+    (*_bench.api->getULDataCB)(&ul);
+    return ul.sz;
+}
+
+static int benchIoSet(int i) {
+    uint8_t v[NB_IOS] = { 0 };
+    v[i%NB_IOS] = 1;
+    (*appcore_sim_getAction(DL_IO_SET))(v, sizeof(v));
+    return sizeof(v);
+}
+
+static int benchIoSetMask(int i) {
+    // 2 ios : mask then their values
+    uint8_t v[3] = { 0x06, i&1, (i>>1)&1 };
+    (*appcore_sim_getAction(DL_IO_SETMASK))(v, sizeof(v));
+    return sizeof(v);
+}
+
+static int benchIoTimed(int i) {
+    // io 2, mode 1, value 1, time 10 (the target may not have io 2 as an output : then it is only parsed)
+    uint8_t v[5] = { 2, 1, 1, 10, 0 };
+    (*appcore_sim_getAction(DL_IO_TIMED))(v, sizeof(v));
+    return sizeof(v);
+}
+
+static int benchCRC8(int i) {
+    unsigned char addr[8] = { 0x28, 0xff, 0x12, 0x34, 0x56, 0x78, (unsigned char)i, 0 };
+    addr[7] = onewireCRC(addr, 7);
+    return 7;
+}
+
+static int benchTempRead(int i) {
+    unsigned char addr[8] = { 0x28, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0 };
+    return (ds18B20_getTemperatureInt(_bench.tempPin, addr)!=0)?2:0;
+}
+
+static int benchUsdistMM(int i) {
+    // echo of ~1m, temperature from -10 to 25 degC
+    volatile uint32_t mm = usdist_echoToMM(5800+(i%64), ((i%36)-10)*16);
+    (void)mm;
+    return 0;
+}
+
+static bool loadBaseline(const char* path, BENCH_RES_t* base, int* nb) {
+    FILE* f = fopen(path, "r");
+    if (f==NULL) {
+        return false;
+    }
+    char line[128];
+    *nb = 0;
+    while(fgets(line, sizeof(line), f)!=NULL && *nb<MAX_CASES) {
+        char name[32];
+        if (line[0]!='#' && sscanf(line, "%31s %lf %lf %d", name, &base[*nb].ns, &base[*nb].simUS, &base[*nb].bytes)==4) {
+            base[*nb].name = strdup(name);
+            (*nb)++;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static void report(const char* basePath) {
+    BENCH_RES_t base[MAX_CASES];
+    int nbBase = 0;
+    if (basePath!=NULL && !loadBaseline(basePath, base, &nbBase)) {
+        fprintf(stderr, "can't read baseline %s\n", basePath);
+    }
+    printf("%-16s %10s %10s %10s %6s", "case", "ns/op", "cycles/op", "devUS/op", "bytes");
+    printf((basePath!=NULL)?" %10s %8s %10s %6s\n":"\n", "base ns", "delta", "devUS", "bytes");
+    for(int i=0;i<_bench.nbRes;i++) {
+        BENCH_RES_t* r = &_bench.res[i];
+        printf("%-16s %10.1f %10.0f %10.1f %6d", r->name, r->ns, r->cycles, r->simUS, r->bytes);
+        for(int b=0;b<nbBase;b++) {
+            if (strcmp(base[b].name, r->name)==0) {
+                double pc = (base[b].ns>0)?((r->ns-base[b].ns)*100/base[b].ns):0;
+                printf(" %10.1f %+7.1f%% %10.1f %6d%s%s%s", base[b].ns, pc, base[b].simUS, base[b].bytes, (pc>SLOWER_PC)?" slower":"", 
+                    (r->simUS!=base[b].simUS)?" device time changed":"", (r->bytes!=base[b].bytes)?" size changed":"");
+            }
+        }
+        printf("\n");
+    }
+}
+
+static bool writeBaseline(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f==NULL) {
+        fprintf(stderr, "can't write baseline %s\n", path);
+        return false;
+    }
+    fprintf(f, "# appcorerun_bench baseline for %s : case ns/op devUS/op bytes\n", MYNEWT_VAL(TARGET_NAME));
+    for(int i=0;i<_bench.nbRes;i++) {
+        fprintf(f, "%s %.1f %.1f %d\n", _bench.res[i].name, _bench.res[i].ns, _bench.res[i].simUS, _bench.res[i].bytes);
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int n = 10000;
+    const char* script = NULL;
+    const char* basePath = NULL;
+    const char* writePath = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "n:s:b:w:"))!=-1) {
+        switch(opt) {
+            case 'n':
+                n = atoi(optarg);
+                break;
+            case 's':
+                script = optarg;
+                break;
+            case 'b':
+                basePath = optarg;
+                break;
+            case 'w':
+                writePath = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-n iterations] [-s script] [-b baseline] [-w baseline]\n", argv[0]);
+                exit(1);
+        }
+    }
+    if (n<=0) {
+        n = 1;
+    }
+    // the sim without logs nor pacing, and the board set up by the script
+    char* simArgv[] = { argv[0], "-x", "-q", "-s", (char*)script, NULL };
+    optind = 1;
+    mcu_sim_parse_args((script!=NULL)?5:3, simArgv);
+    sysinit();
+    for(int i=0;i<APP_MOD_LAST && _bench.api==NULL;i++) {
+        _bench.api = appcore_sim_getModule(i);
+    }
+    if (_bench.api==NULL) {
+        fprintf(stderr, "mod-io not registered\n");
+        exit(1);
+    }
+    for(int p=0;p<SIM_NB_PINS && _bench.tempPin<0;p++) {
+        if (ds18b20_sim_attached(p)) {
+            _bench.tempPin = p;
+        }
+    }
+    // the ios initialised as for a UL cycle
+    (*_bench.api->startCB)();
+    printf("appcorerun_bench %s, %d iterations\n", MYNEWT_VAL(TARGET_NAME), n);
+    runCase("getData", benchGetData, n);
+    runCase("iosetAction", benchIoSet, n);
+    runCase("iosetmaskAction", benchIoSetMask, n);
+    runCase("iotimedAction", benchIoTimed, n);
+    runCase("crc8", benchCRC8, n);
+    if (_bench.tempPin>=0) {
+        runCase("ds18b20Read", benchTempRead, n);
+    }
+    runCase("usdistToMM", benchUsdistMM, n);
+    report(basePath);
+    if (writePath!=NULL && !writeBaseline(writePath)) {
+        exit(1);
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Runs the same accelerated scenario on the sim build of each target, and prints one line per target : ULs, time on air, 
+# awake time and the battery estimate (see the SIM_ syscfgs in syscfg.yml for the power model).
+#   ./compare.sh "<sim options>" <target>...
+#   ./compare.sh "-s scripts/ipev_year.sim -d 365d" wbasev2_io_eu868_ipev_dev wbasev2_io_eu868_none_dev
+if [ $# -lt 2 ]; then
+    echo "usage : $0 \"<sim options>\" <target>..."
+    exit 1
+fi
+OPTS=$1
+shift
+printf "%-32s %8s %12s %12s %12s %10s\n" target ULs "airtime(s)" "awake(s)" "charge(mAh)" "life(days)"
+for t in "$@"; do
+    make -s TARGET=$t >/dev/null || exit 1
+    build/$t/appcorerun_sim -x -q $OPTS | awk -v t=$t '
+        /^ULs /             { uls = $2 }
+        /^airtime /         { air = $2; sub("s", "", air) }
+        /^awake total /     { awake = $3; sub("s", "", awake) }
+        /^charge \(mAh\) /  { charge = $3 }
+        /^battery life /    { life = $3 }
+        END { printf "%-32s %8s %12s %12s %12s %10s\n", t, uls, air, awake, charge, life }'
+done
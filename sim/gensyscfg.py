@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Generates the MYNEWT_VAL defines of the native sim build, as newt would : the defs of each syscfg.yml given, then their vals 
+# in order (so the target overrides the app, and the sim file forces what can't run on the host).
+# usage : gensyscfg.py <target name> <syscfg.yml>...
+import re
+import sys
+
+def value(v):
+    v = v.strip()
+    # comment, if not inside quotes
+    m = re.match(r"^('[^']*'|\"[^\"]*\"|[^#]*?)\s*(#.*)?$", v)
+    if m:
+        v = m.group(1).strip()
+    if len(v) >= 2 and v[0] == v[-1] and v[0] in "'\"":
+        v = v[1:-1]
+    if v in ('true', 'false'):
+        v = '1' if v == 'true' else '0'
+    return v if v != '' else '0'
+
+def parse(path, defs, vals):
+    section = None
+    name = None
+    for line in open(path):
+        line = line.rstrip('\r\n')
+        if re.match(r'^syscfg\.defs\s*:', line):
+            section = defs
+            continue
+        if re.match(r'^syscfg\.vals\s*:', line):
+            section = vals
+            continue
+        if re.match(r'^\S', line):
+            section = None
+            continue
+        if section is None:
+            continue
+        m = re.match(r'^    ([A-Za-z0-9_]+)\s*:\s*(.*)$', line)
+        if m:
+            name = m.group(1)
+            if section is vals:
+                vals[name] = value(m.group(2))
+            continue
+        m = re.match(r'^        value\s*:\s*(.*)$', line)
+        if m and section is defs and name is not None:
+            defs[name] = value(m.group(1))
+
+def main():
+    if len(sys.argv) < 3:
+        print('usage : gensyscfg.py <target name> <syscfg.yml>...')
+        sys.exit(1)
+    defs = {}
+    vals = {}
+    for path in sys.argv[2:]:
+        parse(path, defs, vals)
+    defs.update(vals)
+    defs['TARGET_NAME'] = '"%s"' % sys.argv[1]
+    print('/* generated by gensyscfg.py for %s */' % sys.argv[1])
+    print('#ifndef MYNEWT_VALS_H_')
+    print('#define MYNEWT_VALS_H_')
+    for k in sorted(defs):
+        print('#define MYNEWT_VAL_%s %s' % (k, defs[k]))
+    print('#endif')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,39 @@
+#ifndef APP_CORE_SIM_H_   /* Include guard */
+#define APP_CORE_SIM_H_
+
+#include "os/os.h"
+
+// app-core on the sim : the module cycle and the LoRaWAN UL/DL are run by appcore_sim.c
+typedef enum { APP_MOD_ENV=0, APP_MOD_GPS, APP_MOD_PTI, APP_MOD_LAST } APP_MOD_ID_t;
+typedef enum { EXEC_PARALLEL=0, EXEC_SERIAL } APP_MOD_EXEC_t;
+
+#define APP_CORE_UL_MAX_SZ (250)
+typedef struct {
+    uint8_t payload[APP_CORE_UL_MAX_SZ];
+    uint8_t sz;
+} APP_CORE_UL_t;
+
+typedef uint32_t (*APP_CORE_START_FN_t)();
+typedef void (*APP_CORE_STOP_FN_t)();
+typedef void (*APP_CORE_OFF_FN_t)();
+typedef void (*APP_CORE_DEEPSLEEP_FN_t)();
+typedef bool (*APP_CORE_GETDATA_FN_t)(APP_CORE_UL_t* ul);
+typedef void (*APP_CORE_TIC_FN_t)();
+typedef struct {
+    APP_CORE_START_FN_t startCB;
+    APP_CORE_STOP_FN_t stopCB;
+    APP_CORE_OFF_FN_t offCB;
+    APP_CORE_DEEPSLEEP_FN_t deepsleepCB;
+    APP_CORE_GETDATA_FN_t getULDataCB;
+    APP_CORE_TIC_FN_t ticCB;
+} APP_CORE_API_t;
+typedef void (*ACTIONFN_t)(uint8_t* v, uint8_t l);
+
+void AppCore_registerModule(const char* name, APP_MOD_ID_t id, APP_CORE_API_t* api, APP_MOD_EXEC_t execType);
+void AppCore_registerAction(uint8_t id, ACTIONFN_t fn);
+void AppCore_module_done(APP_MOD_ID_t id);
+bool AppCore_forceUL(int reqModule);
+bool AppCore_isDeviceActive(void);
+void app_core_start(int fwmaj, int fwmin, int fwbuild, const char* fwdate, const char* fwname);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef APP_MSG_SIM_H_   /* Include guard */
+#define APP_MSG_SIM_H_
+
+#include "app-core/app_core.h"
+
+#define APP_CORE_UL_APP_SPECIFIC_START (241)
+#define APP_CORE_DL_APP_SPECIFIC_START (240)
+
+bool app_core_msg_ul_addTLV(APP_CORE_UL_t* ul, uint8_t t, uint8_t l, void* v);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef BSP_SIM_H_   /* Include guard */
+#define BSP_SIM_H_
+
+// Simulated board with the pin names used by the wproto and wbasev2 targets. Scenario scripts use the same names.
+#define SIM_PINS(X) \
+    X(LED_1, 0) X(LED_2, 1) X(EXT_IO, 2) X(EXT_UART_TX, 3) X(EXT_UART_RX, 4) X(SPEAKER, 5) X(BUTTON, 6) \
+    X(CN4_1, 7) X(CN4_2, 8) X(CN4_3, 9) X(CN4_4, 10) X(CN4_5, 11) X(CN4_6, 12) X(CN4_7, 13) X(CN4_8, 14) \
+    X(CN4_9, 15) X(CN4_10, 16) X(CN4_11, 17) X(CN4_12, 18) X(EXT_I2C_SCL, 19) X(EXT_I2C_SDA, 20)
+#define SIM_PIN_ENUM(name, n) name = n,
+enum { SIM_PINS(SIM_PIN_ENUM) SIM_NB_PINS };
+
+// command line of the native build : -s script, see sim README
+void mcu_sim_parse_args(int argc, char** argv);
+
+#endif
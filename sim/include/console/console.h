@@ -0,0 +1,6 @@
+#ifndef CONSOLE_SIM_H_   /* Include guard */
+#define CONSOLE_SIM_H_
+
+int console_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef HAL_GPIO_SIM_H_   /* Include guard */
+#define HAL_GPIO_SIM_H_
+
+// gpios of the simulated board : inputs are driven by the scenario script (see hal_sim.c)
+typedef enum { HAL_GPIO_PULL_NONE=0, HAL_GPIO_PULL_UP, HAL_GPIO_PULL_DOWN } hal_gpio_pull_t;
+typedef enum { HAL_GPIO_TRIG_NONE=0, HAL_GPIO_TRIG_RISING, HAL_GPIO_TRIG_FALLING, HAL_GPIO_TRIG_BOTH } hal_gpio_irq_trig_t;
+typedef void (*hal_gpio_irq_handler_t)(void* arg);
+
+int hal_gpio_init_in(int pin, hal_gpio_pull_t pull);
+int hal_gpio_init_out(int pin, int val);
+void hal_gpio_write(int pin, int val);
+int hal_gpio_read(int pin);
+int hal_gpio_toggle(int pin);
+int hal_gpio_deinit(int pin);
+int hal_gpio_irq_init(int pin, hal_gpio_irq_handler_t handler, void* arg, hal_gpio_irq_trig_t trig, hal_gpio_pull_t pull);
+void hal_gpio_irq_release(int pin);
+void hal_gpio_irq_enable(int pin);
+void hal_gpio_irq_disable(int pin);
+
+#endif
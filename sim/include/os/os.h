@@ -0,0 +1,77 @@
+#ifndef OS_SIM_H_   /* Include guard */
+#define OS_SIM_H_
+
+// The subset of the mynewt OS used by appcorerun, running on the simulated clock (see os_sim.c)
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "syscfg/syscfg.h"
+
+typedef uint32_t os_time_t;
+typedef uint32_t os_sr_t;
+
+struct os_event;
+typedef void os_event_fn(struct os_event* ev);
+struct os_event {
+    uint8_t ev_queued;
+    os_event_fn* ev_cb;
+    void* ev_arg;
+    struct os_event* ev_next;
+};
+struct os_eventq {
+    struct os_event* evq_head;
+    struct os_event* evq_tail;
+};
+struct os_callout {
+    struct os_event c_ev;
+    struct os_eventq* c_evq;
+    uint64_t c_expiryUS;
+    bool c_armed;
+    struct os_callout* c_next;      // in the list of all callouts
+};
+
+#define OS_TICKS_PER_SEC (1000)
+#define OS_TIMEOUT_NEVER (UINT32_MAX)
+#define OS_OK (0)
+// single threaded : nothing interrupts the code
+#define OS_ENTER_CRITICAL(s) do { (s) = 0; } while(0)
+#define OS_EXIT_CRITICAL(s) do { (void)(s); } while(0)
+
+struct os_eventq* os_eventq_dflt_get(void);
+void os_eventq_put(struct os_eventq* evq, struct os_event* ev);
+void os_eventq_run(struct os_eventq* evq);
+void os_callout_init(struct os_callout* c, struct os_eventq* evq, os_event_fn* cb, void* arg);
+int os_callout_reset(struct os_callout* c, os_time_t ticks);
+void os_callout_stop(struct os_callout* c);
+int os_callout_queued(struct os_callout* c);
+os_time_t os_time_get(void);
+void os_time_delay(os_time_t ticks);
+uint32_t os_time_ms_to_ticks32(uint32_t ms);
+uint32_t os_time_ticks_to_ms32(uint32_t ticks);
+int64_t os_get_uptime_usec(void);
+int os_started(void);
+// single threaded : everything runs in 1 task
+struct os_task {
+    const char* t_name;
+};
+struct os_task* os_sched_get_current_task(void);
+
+// cputime at 1MHz, the timers fire on the simulated clock as from an interrupt
+typedef void (*hal_timer_cb)(void* arg);
+struct hal_timer {
+    hal_timer_cb cb;
+    void* arg;
+    uint64_t expiryUS;
+    bool armed;
+    struct hal_timer* next;         // in the list of all timers
+};
+uint32_t os_cputime_get32(void);
+uint32_t os_cputime_ticks_to_usecs(uint32_t ticks);
+uint32_t os_cputime_usecs_to_ticks(uint32_t us);
+void os_cputime_timer_init(struct hal_timer* t, hal_timer_cb cb, void* arg);
+int os_cputime_timer_relative(struct hal_timer* t, uint32_t us);
+void os_cputime_timer_stop(struct hal_timer* t);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef SHELL_SIM_H_   /* Include guard */
+#define SHELL_SIM_H_
+
+typedef int (*shell_cmd_func_t)(int argc, char** argv);
+struct shell_cmd_help;
+struct shell_cmd {
+    const char* sc_cmd;
+    shell_cmd_func_t sc_cmd_func;
+    const struct shell_cmd_help* help;
+};
+int shell_cmd_register(const struct shell_cmd* sc);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SIM_H_   /* Include guard */
+#define SIM_H_
+
+// Internals of the native simulation, shared by the stand-ins
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "app-core/app_core.h"
+
+// simulated clock in us since reset. It only moves when the app waits (next callout/timer) or busy waits.
+uint64_t sim_nowUS();
+void sim_advanceUS(uint32_t us);
+// end of the run : prints the report and exits
+void sim_end(const char* why) __attribute__((noreturn));
+// length of the run in us (-d)
+uint64_t sim_runUS();
+bool sim_isQuiet();
+// -x : no pacing to real time
+bool sim_isAccelerated();
+
+// scenario script (script.c)
+bool script_load(const char* path);
+// '10s', '500ms', '2h'... in us, -1 if bad
+int64_t script_parseTime(const char* s);
+void script_start();
+
+// board (hal_sim.c) : drive an input, set an ADC input (mV), attach a DS18B20 (1/16 degC) or an ultrasonic sensor (mm)
+int hal_sim_pinByName(const char* name);
+void hal_sim_setLevel(int pin, int level);
+void hal_sim_press(int pin, uint32_t ms);
+void hal_sim_pulses(int pin, uint32_t nb, uint32_t periodUS);
+void hal_sim_setFreq(int pin, uint32_t mHz);
+void hal_sim_setADC(int pin, int mV);
+void hal_sim_setTemp(int pin, int temp16);
+void hal_sim_removeTemp(int pin);
+void hal_sim_setDist(int pin, uint32_t mm);
+// 1-Wire device model (ds18b20_sim.c), on the line level changes made by the real onewire.c
+bool ds18b20_sim_attached(int pin);
+void ds18b20_sim_attach(int pin, int temp16);
+void ds18b20_sim_detach(int pin);
+void ds18b20_sim_lineLow(int pin);
+void ds18b20_sim_lineRelease(int pin);
+int ds18b20_sim_read(int pin);
+
+// app-core (appcore_sim.c) : queue a DL for the next UL, set the device active, report
+void appcore_sim_queueDL(uint8_t action, uint8_t* v, uint8_t l);
+void appcore_sim_setActive(bool active);
+void appcore_sim_report();
+// what the app registered, for the bench
+APP_CORE_API_t* appcore_sim_getModule(APP_MOD_ID_t id);
+ACTIONFN_t appcore_sim_getAction(uint8_t id);
+// radio use of the ULs sent so far : number, time on air and RX windows time in us
+uint32_t appcore_sim_getNbULs();
+uint64_t appcore_sim_getAirtimeUS();
+uint64_t appcore_sim_getRxUS();
+// battery estimate (power_sim.c), from the radio use, the awake time of the app and the sleep current
+void power_sim_report();
+// shell commands registered by the app (console_sim.c)
+int console_sim_exec(char* line);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef SYSCFG_SIM_H_   /* Include guard */
+#define SYSCFG_SIM_H_
+
+// values generated by gensyscfg.py from the app, sim and target syscfg.yml
+#include "mynewt_vals.h"
+
+#define MYNEWT_VAL(x) MYNEWT_VAL_ ## x
+
+#endif
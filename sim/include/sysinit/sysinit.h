@@ -0,0 +1,7 @@
+#ifndef SYSINIT_SIM_H_   /* Include guard */
+#define SYSINIT_SIM_H_
+
+// calls the package init functions of the app (pkg.init)
+void sysinit(void);
+
+#endif
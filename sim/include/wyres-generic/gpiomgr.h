@@ -0,0 +1,18 @@
+#ifndef GPIOMGR_SIM_H_   /* Include guard */
+#define GPIOMGR_SIM_H_
+
+#include <stdint.h>
+
+typedef enum { HIGH_Z=0, PULL_UP, PULL_DOWN, OUT_0, OUT_1 } GPIO_IDLE_TYPE;
+typedef enum { LP_RUN=0, LP_DOZE, LP_SLEEP, LP_DEEPSLEEP, LP_OFF } LP_MODE_t;
+
+void* GPIO_define_in(const char* name, int8_t gpio, GPIO_IDLE_TYPE pull, LP_MODE_t offmode, GPIO_IDLE_TYPE offtype);
+void* GPIO_define_out(const char* name, int8_t gpio, uint8_t initialvalue, LP_MODE_t offmode, GPIO_IDLE_TYPE offtype);
+void* GPIO_define_adc(const char* name, int8_t gpio, int chan, LP_MODE_t offmode, GPIO_IDLE_TYPE offtype);
+int GPIO_read(int8_t gpio);
+// in mV, from the scenario script
+int GPIO_readADC(int8_t gpio);
+int GPIO_write(int8_t gpio, uint8_t value);
+void GPIO_release(int8_t gpio);
+
+#endif
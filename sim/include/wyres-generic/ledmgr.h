@@ -0,0 +1,6 @@
+#ifndef LEDMGR_SIM_H_   /* Include guard */
+#define LEDMGR_SIM_H_
+
+// not used by appcorerun on the sim
+
+#endif
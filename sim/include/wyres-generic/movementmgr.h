@@ -0,0 +1,6 @@
+#ifndef MOVEMENTMGR_SIM_H_   /* Include guard */
+#define MOVEMENTMGR_SIM_H_
+
+// not used by appcorerun on the sim
+
+#endif
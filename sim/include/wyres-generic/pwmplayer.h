@@ -0,0 +1,11 @@
+#ifndef PWMPLAYER_SIM_H_   /* Include guard */
+#define PWMPLAYER_SIM_H_
+
+#include <stdint.h>
+
+// the tunes are only logged
+void PWM_define(const char* name, int8_t gpio, int freq);
+void PWM_play(int8_t gpio, const char* tune, int bpm);
+void PWM_addPWM(int8_t gpio, int freq, int dutyPct, uint32_t durationMS);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef REBOOTMGR_SIM_H_   /* Include guard */
+#define REBOOTMGR_SIM_H_
+
+// not used by appcorerun on the sim
+
+#endif
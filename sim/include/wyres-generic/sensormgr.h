@@ -0,0 +1,18 @@
+#ifndef SENSORMGR_SIM_H_   /* Include guard */
+#define SENSORMGR_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum { SR_BUTTON_RELEASED=0, SR_BUTTON_PRESSED } SR_BUTTON_STATE_t;
+typedef enum { SR_BUTTON_SHORT=1, SR_BUTTON_MED, SR_BUTTON_LONG, SR_BUTTON_VLONG } SR_BUTTON_PRESS_TYPE_t;
+typedef void (*SR_BUTTON_CB_FN_t)(void* ctx, SR_BUTTON_STATE_t currentState, SR_BUTTON_PRESS_TYPE_t currentPressType);
+
+// buttons are active low inputs : 'press' and 'in' in the scenario script
+bool SRMgr_defineButton(int8_t gpio);
+bool SRMgr_registerButtonCB(int8_t gpio, SR_BUTTON_CB_FN_t cb, void* ctx);
+uint32_t SRMgr_getLastButtonReleaseTS(int8_t gpio);
+uint32_t SRMgr_getLastButtonPressTS(int8_t gpio);
+SR_BUTTON_PRESS_TYPE_t SRMgr_getLastButtonPressType(int8_t gpio);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef TIMEMGR_SIM_H_   /* Include guard */
+#define TIMEMGR_SIM_H_
+
+#include <stdint.h>
+
+uint32_t TMMgr_getRelTimeMS(void);
+uint32_t TMMgr_getRelTimeSecs(void);
+// busy wait : moves the simulated clock on
+void TMMgr_busySleep(uint32_t ms);
+
+#endif
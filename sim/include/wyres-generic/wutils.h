@@ -0,0 +1,13 @@
+#ifndef WUTILS_SIM_H_   /* Include guard */
+#define WUTILS_SIM_H_
+
+#include "os/os.h"
+
+// logs go to stdout with the simulated time (-q to silence)
+void log_debug(const char* ls, ...);
+void log_info(const char* ls, ...);
+void log_warn(const char* ls, ...);
+void log_error(const char* ls, ...);
+void log_noout(const char* ls, ...);
+
+#endif
@@ -0,0 +1,257 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * app-core and LoRaWAN stand-in for the sim : runs the module cycle (start the modules, wait for them to be done or for the longest 
+ * time they asked, get their UL data, stop them) every idle period, and 'sends' the UL. DLs queued by the scenario script are 
+ * delivered to the registered actions after the next UL, as in the RX windows of a class A device.
+ * Each UL is counted with its time on air at LORA_DEFAULT_SF (EU868, 125kHz, CR 4/5) and the time of the 2 RX windows after it.
+ */
+#include "os/os.h"
+#include "wyres-generic/wutils.h"
+#include "app-core/app_core.h"
+#include "app-core/app_msg.h"
+#include "sim.h"
+
+#define MAX_ACTIONS (16)
+#define MAX_DLS (16)
+#define MAX_DL_SZ (32)
+// MHDR, FHDR without options, FPort and MIC around the app payload
+#define LORAWAN_OVERHEAD (13)
+#define LORA_PREAMBLE (8)
+
+static struct {
+    struct {
+        const char* name;
+        APP_CORE_API_t* api;
+        bool done;
+    } mods[APP_MOD_LAST];
+    struct {
+        uint8_t id;
+        ACTIONFN_t fn;
+    } actions[MAX_ACTIONS];
+    int nbActions;
+    struct {
+        uint8_t action;
+        uint8_t l;
+        uint8_t v[MAX_DL_SZ];
+    } dls[MAX_DLS];
+    int nbDLs;
+    struct os_callout cycleTimer;       // next cycle, or end of the start phase of the modules
+    bool inCycle;
+    bool forced;
+    bool active;
+    uint32_t nbULs;
+    uint32_t nbForcedULs;
+    uint32_t nbDLsDone;
+    uint32_t nbULBytes;
+    uint64_t airtimeUS;
+    uint64_t rxUS;
+} _ac = {
+    .active = true,
+};
+
+static uint32_t idleMS() {
+    return _ac.active?(MYNEWT_VAL(IDLETIME_NOTMOVING_MINS)*60000):(MYNEWT_VAL(IDLETIME_INACTIVE_MINS)*60000);
+}
+
+static void startCycle() {
+    uint32_t waitMS = 0;
+    _ac.inCycle = true;
+    for(int i=0;i<APP_MOD_LAST;i++) {
+        if (_ac.mods[i].api!=NULL) {
+            _ac.mods[i].done = false;
+            uint32_t ms = (*_ac.mods[i].api->startCB)();
+            if (ms>waitMS) {
+                waitMS = ms;
+            }
+        }
+    }
+    os_callout_reset(&_ac.cycleTimer, os_time_ms_to_ticks32(waitMS));
+}
+
+static void deliverDLs() {
+    for(int d=0;d<_ac.nbDLs;d++) {
+        bool found = false;
+        for(int i=0;i<_ac.nbActions;i++) {
+            if (_ac.actions[i].id==_ac.dls[d].action) {
+                log_info("SIM:DL action %d, %d bytes", _ac.dls[d].action, _ac.dls[d].l);
+                (*_ac.actions[i].fn)(_ac.dls[d].v, _ac.dls[d].l);
+                _ac.nbDLsDone++;
+                found = true;
+            }
+        }
+        if (!found) {
+            log_warn("SIM:DL action %d not registered", _ac.dls[d].action);
+        }
+    }
+    _ac.nbDLs = 0;
+}
+
+// LoRa time on air of a frame (semtech AN1200.13) : explicit header, CRC on, low data rate optimisation from SF11
+static uint32_t airtimeUS(int sf, int pl) {
+    uint32_t symUS = (1<<sf)*8;         // 2^SF/125kHz
+    int de = (sf>=11)?1:0;
+    int num = 8*pl - 4*sf + 28 + 16;
+    int den = 4*(sf - 2*de);
+    int nb = 8 + ((num>0)?((num+den-1)/den)*5:0);
+    return (symUS*(4*LORA_PREAMBLE+17))/4 + nb*symUS;
+}
+
+static void sendUL(APP_CORE_UL_t* ul) {
+    char hex[APP_CORE_UL_MAX_SZ*2+1];
+    for(int i=0;i<ul->sz;i++) {
+        sprintf(&hex[i*2], "%02x", ul->payload[i]);
+    }
+    hex[ul->sz*2] = '\0';
+    _ac.nbULs++;
+    _ac.nbULBytes += ul->sz;
+    _ac.airtimeUS += airtimeUS(MYNEWT_VAL(LORA_DEFAULT_SF), ul->sz+LORAWAN_OVERHEAD);
+    _ac.rxUS += 2*MYNEWT_VAL(SIM_RX_WINDOW_MS)*1000;
+    log_info("SIM:UL %d, %d bytes : %s", _ac.nbULs, ul->sz, hex);
+    deliverDLs();
+}
+
+static void endCycle() {
+    APP_CORE_UL_t ul;
+    ul.sz = 0;
+    for(int i=0;i<APP_MOD_LAST;i++) {
+        if (_ac.mods[i].api!=NULL) {
+            (*_ac.mods[i].api->getULDataCB)(&ul);
+            (*_ac.mods[i].api->stopCB)();
+        }
+    }
+    _ac.inCycle = false;
+    sendUL(&ul);
+    if (_ac.forced) {
+        _ac.forced = false;
+        os_callout_reset(&_ac.cycleTimer, 0);
+    } else {
+        os_callout_reset(&_ac.cycleTimer, os_time_ms_to_ticks32(idleMS()));
+    }
+}
+
+static void cycleEvent(struct os_event* e) {
+    if (_ac.inCycle) {
+        endCycle();
+    } else {
+        startCycle();
+    }
+}
+
+void AppCore_registerModule(const char* name, APP_MOD_ID_t id, APP_CORE_API_t* api, APP_MOD_EXEC_t execType) {
+    if (id<APP_MOD_LAST) {
+        _ac.mods[id].name = name;
+        _ac.mods[id].api = api;
+    }
+}
+
+void AppCore_registerAction(uint8_t id, ACTIONFN_t fn) {
+    if (_ac.nbActions<MAX_ACTIONS) {
+        _ac.actions[_ac.nbActions].id = id;
+        _ac.actions[_ac.nbActions].fn = fn;
+        _ac.nbActions++;
+    }
+}
+
+// a module has its data : end the start phase if it was the last one
+void AppCore_module_done(APP_MOD_ID_t id) {
+    if (id>=APP_MOD_LAST || !_ac.inCycle) {
+        return;
+    }
+    _ac.mods[id].done = true;
+    for(int i=0;i<APP_MOD_LAST;i++) {
+        if (_ac.mods[i].api!=NULL && !_ac.mods[i].done) {
+            return;
+        }
+    }
+    os_callout_reset(&_ac.cycleTimer, 0);
+}
+
+bool AppCore_forceUL(int reqModule) {
+    _ac.nbForcedULs++;
+    if (_ac.inCycle) {
+        _ac.forced = true;
+    } else {
+        os_callout_reset(&_ac.cycleTimer, 0);
+    }
+    return true;
+}
+
+bool AppCore_isDeviceActive(void) {
+    return _ac.active;
+}
+
+void app_core_start(int fwmaj, int fwmin, int fwbuild, const char* fwdate, const char* fwname) {
+    os_callout_init(&_ac.cycleTimer, os_eventq_dflt_get(), cycleEvent, NULL);
+    // joined straight away
+    os_callout_reset(&_ac.cycleTimer, 0);
+}
+
+bool app_core_msg_ul_addTLV(APP_CORE_UL_t* ul, uint8_t t, uint8_t l, void* v) {
+    if (ul->sz+2+l>APP_CORE_UL_MAX_SZ) {
+        return false;
+    }
+    ul->payload[ul->sz++] = t;
+    ul->payload[ul->sz++] = l;
+    memcpy(&ul->payload[ul->sz], v, l);
+    ul->sz += l;
+    return true;
+}
+
+void appcore_sim_queueDL(uint8_t action, uint8_t* v, uint8_t l) {
+    if (_ac.nbDLs>=MAX_DLS || l>MAX_DL_SZ) {
+        log_warn("SIM:DL not queued");
+        return;
+    }
+    _ac.dls[_ac.nbDLs].action = action;
+    _ac.dls[_ac.nbDLs].l = l;
+    memcpy(_ac.dls[_ac.nbDLs].v, v, l);
+    _ac.nbDLs++;
+}
+
+void appcore_sim_setActive(bool active) {
+    _ac.active = active;
+}
+
+APP_CORE_API_t* appcore_sim_getModule(APP_MOD_ID_t id) {
+    return (id<APP_MOD_LAST)?_ac.mods[id].api:NULL;
+}
+
+ACTIONFN_t appcore_sim_getAction(uint8_t id) {
+    for(int i=0;i<_ac.nbActions;i++) {
+        if (_ac.actions[i].id==id) {
+            return _ac.actions[i].fn;
+        }
+    }
+    return NULL;
+}
+
+uint32_t appcore_sim_getNbULs() {
+    return _ac.nbULs;
+}
+
+uint64_t appcore_sim_getAirtimeUS() {
+    return _ac.airtimeUS;
+}
+
+uint64_t appcore_sim_getRxUS() {
+    return _ac.rxUS;
+}
+
+void appcore_sim_report() {
+    printf("ULs             %lu (%lu forced requests)\n", (unsigned long)_ac.nbULs, (unsigned long)_ac.nbForcedULs);
+    printf("UL bytes        %lu\n", (unsigned long)_ac.nbULBytes);
+    printf("airtime         %lu.%03lus at SF%d\n", (unsigned long)(_ac.airtimeUS/1000000), (unsigned long)((_ac.airtimeUS/1000)%1000), 
+        MYNEWT_VAL(LORA_DEFAULT_SF));
+    printf("DLs             %lu\n", (unsigned long)_ac.nbDLsDone);
+}
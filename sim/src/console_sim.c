@@ -0,0 +1,106 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Logs and console of the sim : the wyres log calls and the console go to stdout, stamped with the simulated time. The shell 
+ * commands registered by the app can be run from the scenario script.
+ */
+#include <stdarg.h>
+
+#include "os/os.h"
+#include "wyres-generic/wutils.h"
+#include "console/console.h"
+#include "shell/shell.h"
+#include "sim.h"
+
+#define MAX_CMDS (8)
+#define MAX_ARGS (8)
+
+static const struct shell_cmd* _cmds[MAX_CMDS];
+static int _nbCmds = 0;
+
+static void logv(char lvl, const char* ls, va_list vl) {
+    if (sim_isQuiet()) {
+        return;
+    }
+    uint64_t ms = sim_nowUS()/1000;
+    printf("%6lu.%03lu %c ", (unsigned long)(ms/1000), (unsigned long)(ms%1000), lvl);
+    vprintf(ls, vl);
+    printf("\n");
+}
+
+void log_debug(const char* ls, ...) {
+    va_list vl;
+    va_start(vl, ls);
+    logv('D', ls, vl);
+    va_end(vl);
+}
+
+void log_info(const char* ls, ...) {
+    va_list vl;
+    va_start(vl, ls);
+    logv('I', ls, vl);
+    va_end(vl);
+}
+
+void log_warn(const char* ls, ...) {
+    va_list vl;
+    va_start(vl, ls);
+    logv('W', ls, vl);
+    va_end(vl);
+}
+
+void log_error(const char* ls, ...) {
+    va_list vl;
+    va_start(vl, ls);
+    logv('E', ls, vl);
+    va_end(vl);
+}
+
+void log_noout(const char* ls, ...) {
+}
+
+// console output is always shown
+int console_printf(const char* fmt, ...) {
+    va_list vl;
+    va_start(vl, fmt);
+    int n = vprintf(fmt, vl);
+    va_end(vl);
+    return n;
+}
+
+int shell_cmd_register(const struct shell_cmd* sc) {
+    if (_nbCmds>=MAX_CMDS) {
+        return -1;
+    }
+    _cmds[_nbCmds++] = sc;
+    return 0;
+}
+
+// run a shell command line (modified in place)
+int console_sim_exec(char* line) {
+    char* argv[MAX_ARGS];
+    int argc = 0;
+    for(char* tok=strtok(line, " \t");tok!=NULL && argc<MAX_ARGS;tok=strtok(NULL, " \t")) {
+        argv[argc++] = tok;
+    }
+    if (argc==0) {
+        return -1;
+    }
+    for(int i=0;i<_nbCmds;i++) {
+        if (strcmp(argv[0], _cmds[i]->sc_cmd)==0) {
+            return (*_cmds[i]->sc_cmd_func)(argc, argv);
+        }
+    }
+    console_printf("unknown command [%s]\n", argv[0]);
+    return -1;
+}
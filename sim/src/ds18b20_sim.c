@@ -0,0 +1,203 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * DS18B20 model for the sim : it follows the line level changes made by the real bit banging in onewire.c and answers as the 
+ * sensor would (presence after reset, write slots by the length of the low pulse, read slots driven by the device). 
+ * Supports read ROM, skip ROM, match ROM, convert T (750ms, the line reads 0 until done) and read scratchpad.
+ */
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "sim.h"
+
+#define RESET_MIN_US (480)
+#define WRITE1_MAX_US (15)
+#define CONV_US (750000)
+// temperature register at power up : 85 degC
+#define POWERUP_TEMP16 (85*16)
+
+typedef enum { DS_ROM=0, DS_MATCH, DS_FUNC, DS_SEND, DS_CONV, DS_IDLE } DS_STATE;
+
+static struct ds {
+    bool attached;
+    int temp16;                 // current temperature, from the script
+    int reg16;                  // temperature register, set by a conversion
+    int conv16;                 // value of the conversion in progress
+    uint8_t rom[8];
+    bool low;
+    uint64_t lowTS;
+    bool presence;
+    DS_STATE state;
+    uint8_t rx;
+    int rxBits;
+    int matched;
+    uint8_t tx[9];
+    int txLen;
+    int txBit;
+    uint64_t convEndUS;
+    int slotBit;                // bit driven in the current read slot, -1 if none
+} _ds[SIM_NB_PINS];
+
+static uint8_t crc8(uint8_t* d, int len) {
+    uint8_t crc = 0;
+    for(int i=0;i<len;i++) {
+        uint8_t b = d[i];
+        for(int j=0;j<8;j++) {
+            uint8_t mix = (crc ^ b) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            b >>= 1;
+        }
+    }
+    return crc;
+}
+
+bool ds18b20_sim_attached(int pin) {
+    return (pin>=0 && pin<SIM_NB_PINS && _ds[pin].attached);
+}
+
+void ds18b20_sim_detach(int pin) {
+    _ds[pin].attached = false;
+}
+
+void ds18b20_sim_attach(int pin, int temp16) {
+    struct ds* d = &_ds[pin];
+    if (!d->attached) {
+        d->attached = true;
+        d->reg16 = POWERUP_TEMP16;
+        d->slotBit = -1;
+        d->state = DS_IDLE;
+        uint8_t rom[8] = { 0x28, (uint8_t)pin, 0x5A, 0x17, 0x00, 0x00, 0x00, 0 };
+        rom[7] = crc8(rom, 7);
+        memcpy(d->rom, rom, 8);
+    }
+    d->temp16 = temp16;
+}
+
+static void send(struct ds* d, uint8_t* data, int len) {
+    memcpy(d->tx, data, len);
+    d->txLen = len;
+    d->txBit = 0;
+    d->state = DS_SEND;
+}
+
+// the register gets the new value at the end of a conversion
+static void convUpdate(struct ds* d) {
+    if (d->convEndUS>0 && sim_nowUS()>=d->convEndUS) {
+        d->reg16 = d->conv16;
+        d->convEndUS = 0;
+    }
+}
+
+static void rxByte(struct ds* d, uint8_t b) {
+    convUpdate(d);
+    switch(d->state) {
+        case DS_ROM: {
+            if (b==0x33) {
+                send(d, d->rom, 8);
+            } else if (b==0xCC) {
+                d->state = DS_FUNC;
+            } else if (b==0x55) {
+                d->matched = 0;
+                d->state = DS_MATCH;
+            } else {
+                d->state = DS_IDLE;
+            }
+            break;
+        }
+        case DS_MATCH: {
+            if (b!=d->rom[d->matched]) {
+                d->state = DS_IDLE;
+            } else if (++d->matched==8) {
+                d->state = DS_FUNC;
+            }
+            break;
+        }
+        case DS_FUNC: {
+            if (b==0x44) {
+                d->convEndUS = sim_nowUS()+CONV_US;
+                d->conv16 = d->temp16;
+                d->state = DS_CONV;
+            } else if (b==0xBE) {
+                int16_t t = d->reg16;
+                uint8_t sp[9] = { (uint8_t)(t & 0xff), (uint8_t)((t>>8) & 0xff), 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0 };
+                sp[8] = crc8(sp, 8);
+                send(d, sp, 9);
+            } else {
+                d->state = DS_IDLE;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void ds18b20_sim_lineLow(int pin) {
+    struct ds* d = &_ds[pin];
+    if (d->low) {
+        return;
+    }
+    d->low = true;
+    d->lowTS = sim_nowUS();
+    d->slotBit = -1;
+    // the device drives the read slots when it has something to say
+    if (d->state==DS_SEND && d->txBit<d->txLen*8) {
+        d->slotBit = (d->tx[d->txBit/8]>>(d->txBit%8)) & 0x01;
+        d->txBit++;
+    } else if (d->state==DS_CONV) {
+        convUpdate(d);
+        d->slotBit = (d->convEndUS==0)?1:0;
+    }
+}
+
+void ds18b20_sim_lineRelease(int pin) {
+    struct ds* d = &_ds[pin];
+    if (!d->low) {
+        return;
+    }
+    d->low = false;
+    uint64_t lowUS = sim_nowUS()-d->lowTS;
+    if (lowUS>=RESET_MIN_US) {
+        d->presence = true;
+        d->state = DS_ROM;
+        d->rxBits = 0;
+        d->rx = 0;
+        d->txLen = 0;
+        d->slotBit = -1;
+        return;
+    }
+    if (d->slotBit>=0) {
+        return;         // read slot : the device holds its bit until the next slot
+    }
+    // write slot, LS bit first
+    d->rx |= ((lowUS<WRITE1_MAX_US)?1:0)<<d->rxBits;
+    if (++d->rxBits==8) {
+        rxByte(d, d->rx);
+        d->rx = 0;
+        d->rxBits = 0;
+    }
+}
+
+int ds18b20_sim_read(int pin) {
+    struct ds* d = &_ds[pin];
+    if (d->presence) {
+        d->presence = false;
+        return 0;
+    }
+    if (d->slotBit>=0) {
+        return d->slotBit;
+    }
+    return 1;
+}
@@ -0,0 +1,477 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * The simulated board : gpios with interrupts, the wyres gpio/button/pwm managers and the time manager. Inputs are driven by the 
+ * scenario script : levels, button presses, pulse trains and frequencies, ADC voltages. A DS18B20 can be attached to a pin (it 
+ * answers the real 1-Wire bit banging, see ds18b20_sim.c), and an ultrasonic sensor to an echo pin : a trigger pulse on any output 
+ * gets an echo pulse for the set distance.
+ */
+#include <stdlib.h>
+
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "hal/hal_gpio.h"
+#include "wyres-generic/wutils.h"
+#include "wyres-generic/gpiomgr.h"
+#include "wyres-generic/sensormgr.h"
+#include "wyres-generic/pwmplayer.h"
+#include "wyres-generic/timemgr.h"
+#include "sim.h"
+
+// time from the end of the trigger pulse to the echo rising edge (the burst)
+#define ECHO_DELAY_US (450)
+// echo time per mm there and back, at 20degC (343.4 m/s)
+#define ECHO_US(mm) ((mm)*20000/3434)
+#define MIN_TRIG_US (8)
+
+static struct simpin {
+    bool init;
+    bool out;
+    int outLevel;
+    int inLevel;                // driven from outside, -1 if not (the pull decides)
+    hal_gpio_pull_t pull;
+    hal_gpio_irq_handler_t irq;
+    void* irqArg;
+    hal_gpio_irq_trig_t trig;
+    bool irqEnabled;
+    int mV;
+    // sensormgr button
+    bool button;
+    SR_BUTTON_CB_FN_t btnCB;
+    void* btnCtx;
+    uint32_t pressTS;
+    uint32_t releaseTS;
+    SR_BUTTON_PRESS_TYPE_t pressType;
+    struct hal_timer releaseTimer;
+    // pulse train and frequency
+    uint32_t pulsesLeft;
+    uint32_t pulsePeriodUS;
+    uint32_t freqPeriodUS;
+    struct hal_timer pulseTimer;
+    // ultrasonic sensor echo on this pin
+    uint32_t distMM;
+    bool echoHigh;
+    struct hal_timer echoTimer;
+    uint64_t highTS;            // output rising edge, to see trigger pulses
+} _pins[SIM_NB_PINS];
+
+static const struct {
+    const char* name;
+    int pin;
+} _pinNames[] = {
+#define SIM_PIN_NAME(name, n) { #name, n },
+    SIM_PINS(SIM_PIN_NAME)
+};
+
+static void releaseEnd(void* arg);
+static void pulseEdge(void* arg);
+static void echoEdge(void* arg);
+
+static struct simpin* getPin(int pin) {
+    if (pin<0 || pin>=SIM_NB_PINS) {
+        return NULL;
+    }
+    struct simpin* p = &_pins[pin];
+    if (!p->init) {
+        p->init = true;
+        p->inLevel = -1;
+        p->pull = HAL_GPIO_PULL_UP;
+        os_cputime_timer_init(&p->releaseTimer, releaseEnd, (void*)(intptr_t)pin);
+        os_cputime_timer_init(&p->pulseTimer, pulseEdge, (void*)(intptr_t)pin);
+        os_cputime_timer_init(&p->echoTimer, echoEdge, (void*)(intptr_t)pin);
+    }
+    return p;
+}
+
+static int level(int pin) {
+    struct simpin* p = getPin(pin);
+    if (p->out) {
+        return p->outLevel;
+    }
+    if (ds18b20_sim_attached(pin)) {
+        return ds18b20_sim_read(pin);
+    }
+    if (p->inLevel>=0) {
+        return p->inLevel;
+    }
+    // undriven : the sensor lines have external pull ups
+    return (p->pull==HAL_GPIO_PULL_DOWN)?0:1;
+}
+
+static SR_BUTTON_PRESS_TYPE_t pressType(uint32_t ms) {
+    if (ms<1000) {
+        return SR_BUTTON_SHORT;
+    } else if (ms<3000) {
+        return SR_BUTTON_MED;
+    } else if (ms<6000) {
+        return SR_BUTTON_LONG;
+    }
+    return SR_BUTTON_VLONG;
+}
+
+// input level change : interrupt and button callbacks
+static void edge(int pin, int newLevel) {
+    struct simpin* p = getPin(pin);
+    if (p->irq!=NULL && p->irqEnabled && 
+            (p->trig==HAL_GPIO_TRIG_BOTH || (p->trig==HAL_GPIO_TRIG_RISING && newLevel) || (p->trig==HAL_GPIO_TRIG_FALLING && !newLevel))) {
+        (*p->irq)(p->irqArg);
+    }
+    if (p->button) {
+        // active low
+        if (newLevel==0) {
+            p->pressTS = TMMgr_getRelTimeMS();
+            if (p->btnCB!=NULL) {
+                (*p->btnCB)(p->btnCtx, SR_BUTTON_PRESSED, 0);
+            }
+        } else {
+            p->releaseTS = TMMgr_getRelTimeMS();
+            p->pressType = pressType(p->releaseTS-p->pressTS);
+            if (p->btnCB!=NULL) {
+                (*p->btnCB)(p->btnCtx, SR_BUTTON_RELEASED, p->pressType);
+            }
+        }
+    }
+}
+
+void hal_sim_setLevel(int pin, int lvl) {
+    struct simpin* p = getPin(pin);
+    if (p==NULL) {
+        return;
+    }
+    int old = level(pin);
+    p->inLevel = (lvl!=0)?1:0;
+    if (level(pin)!=old) {
+        edge(pin, level(pin));
+    }
+}
+
+static void releaseEnd(void* arg) {
+    hal_sim_setLevel((int)(intptr_t)arg, 1);
+}
+
+void hal_sim_press(int pin, uint32_t ms) {
+    struct simpin* p = getPin(pin);
+    if (p==NULL) {
+        return;
+    }
+    hal_sim_setLevel(pin, 0);
+    os_cputime_timer_relative(&p->releaseTimer, ms*1000);
+}
+
+// falling then rising edge for each pulse
+static void pulseEdge(void* arg) {
+    int pin = (int)(intptr_t)arg;
+    struct simpin* p = getPin(pin);
+    uint32_t period = (p->pulsesLeft>0)?p->pulsePeriodUS:p->freqPeriodUS;
+    if (period==0) {
+        return;
+    }
+    if (level(pin)) {
+        hal_sim_setLevel(pin, 0);
+        os_cputime_timer_relative(&p->pulseTimer, period/2);
+        return;
+    }
+    hal_sim_setLevel(pin, 1);
+    if (p->pulsesLeft>0) {
+        p->pulsesLeft--;
+    }
+    // a frequency only makes edges while someone listens
+    if (p->pulsesLeft>0 || (p->freqPeriodUS>0 && p->irqEnabled)) {
+        os_cputime_timer_relative(&p->pulseTimer, period-period/2);
+    }
+}
+
+void hal_sim_pulses(int pin, uint32_t nb, uint32_t periodUS) {
+    struct simpin* p = getPin(pin);
+    if (p==NULL || nb==0 || periodUS<2) {
+        return;
+    }
+    p->pulsesLeft = nb;
+    p->pulsePeriodUS = periodUS;
+    if (!p->pulseTimer.armed) {
+        os_cputime_timer_relative(&p->pulseTimer, 0);
+    }
+}
+
+void hal_sim_setFreq(int pin, uint32_t mHz) {
+    struct simpin* p = getPin(pin);
+    if (p==NULL) {
+        return;
+    }
+    p->freqPeriodUS = (mHz>0)?(uint32_t)(1000000000ULL/mHz):0;
+    if (p->freqPeriodUS>=2 && p->irqEnabled && !p->pulseTimer.armed) {
+        os_cputime_timer_relative(&p->pulseTimer, 0);
+    }
+}
+
+void hal_sim_setADC(int pin, int mV) {
+    struct simpin* p = getPin(pin);
+    if (p!=NULL) {
+        p->mV = mV;
+    }
+}
+
+void hal_sim_setTemp(int pin, int temp16) {
+    if (getPin(pin)!=NULL) {
+        ds18b20_sim_attach(pin, temp16);
+    }
+}
+
+void hal_sim_removeTemp(int pin) {
+    if (getPin(pin)!=NULL) {
+        ds18b20_sim_detach(pin);
+    }
+}
+
+void hal_sim_setDist(int pin, uint32_t mm) {
+    struct simpin* p = getPin(pin);
+    if (p!=NULL) {
+        p->distMM = mm;
+    }
+}
+
+static void echoEdge(void* arg) {
+    int pin = (int)(intptr_t)arg;
+    struct simpin* p = getPin(pin);
+    p->echoHigh = !p->echoHigh;
+    hal_sim_setLevel(pin, p->echoHigh?1:0);
+    if (p->echoHigh) {
+        os_cputime_timer_relative(&p->echoTimer, ECHO_US(p->distMM));
+    }
+}
+
+// trigger pulse on an output : the ultrasonic sensors listening on their echo pin answer
+static void trigger() {
+    for(int i=0;i<SIM_NB_PINS;i++) {
+        struct simpin* e = &_pins[i];
+        if (e->init && e->distMM>0 && e->irqEnabled && !e->echoTimer.armed) {
+            e->echoHigh = false;
+            os_cputime_timer_relative(&e->echoTimer, ECHO_DELAY_US);
+        }
+    }
+}
+
+static void drive(int pin, int v) {
+    struct simpin* p = getPin(pin);
+    int old = p->out?p->outLevel:-1;
+    p->out = true;
+    p->outLevel = (v!=0)?1:0;
+    if (ds18b20_sim_attached(pin)) {
+        if (p->outLevel==0) {
+            ds18b20_sim_lineLow(pin);
+        } else {
+            ds18b20_sim_lineRelease(pin);
+        }
+    }
+    if (old!=1 && p->outLevel==1) {
+        p->highTS = sim_nowUS();
+    } else if (old==1 && p->outLevel==0 && sim_nowUS()-p->highTS>=MIN_TRIG_US && !ds18b20_sim_attached(pin)) {
+        trigger();
+    }
+}
+
+int hal_gpio_init_in(int pin, hal_gpio_pull_t pull) {
+    struct simpin* p = getPin(pin);
+    if (p==NULL) {
+        return -1;
+    }
+    bool wasLow = (p->out && p->outLevel==0);
+    p->out = false;
+    p->pull = pull;
+    if (wasLow && ds18b20_sim_attached(pin)) {
+        ds18b20_sim_lineRelease(pin);
+    }
+    return 0;
+}
+
+int hal_gpio_init_out(int pin, int val) {
+    if (getPin(pin)==NULL) {
+        return -1;
+    }
+    drive(pin, val);
+    return 0;
+}
+
+void hal_gpio_write(int pin, int val) {
+    if (getPin(pin)!=NULL) {
+        drive(pin, val);
+    }
+}
+
+int hal_gpio_read(int pin) {
+    if (getPin(pin)==NULL) {
+        return 0;
+    }
+    return level(pin);
+}
+
+int hal_gpio_toggle(int pin) {
+    if (getPin(pin)==NULL) {
+        return 0;
+    }
+    drive(pin, !level(pin));
+    return level(pin);
+}
+
+int hal_gpio_deinit(int pin) {
+    return hal_gpio_init_in(pin, HAL_GPIO_PULL_NONE);
+}
+
+int hal_gpio_irq_init(int pin, hal_gpio_irq_handler_t handler, void* arg, hal_gpio_irq_trig_t trig, hal_gpio_pull_t pull) {
+    struct simpin* p = getPin(pin);
+    if (p==NULL) {
+        return -1;
+    }
+    hal_gpio_init_in(pin, pull);
+    p->irq = handler;
+    p->irqArg = arg;
+    p->trig = trig;
+    p->irqEnabled = false;
+    return 0;
+}
+
+void hal_gpio_irq_release(int pin) {
+    struct simpin* p = getPin(pin);
+    if (p!=NULL) {
+        p->irq = NULL;
+        p->irqEnabled = false;
+    }
+}
+
+void hal_gpio_irq_enable(int pin) {
+    struct simpin* p = getPin(pin);
+    if (p==NULL) {
+        return;
+    }
+    p->irqEnabled = true;
+    if (p->freqPeriodUS>=2 && !p->pulseTimer.armed) {
+        os_cputime_timer_relative(&p->pulseTimer, 0);
+    }
+}
+
+void hal_gpio_irq_disable(int pin) {
+    struct simpin* p = getPin(pin);
+    if (p!=NULL) {
+        p->irqEnabled = false;
+    }
+}
+
+int hal_sim_pinByName(const char* name) {
+    for(int i=0;i<(int)(sizeof(_pinNames)/sizeof(_pinNames[0]));i++) {
+        if (strcmp(name, _pinNames[i].name)==0) {
+            return _pinNames[i].pin;
+        }
+    }
+    char* end;
+    long n = strtol(name, &end, 0);
+    return (*end=='\0' && n>=0 && n<SIM_NB_PINS)?(int)n:-1;
+}
+
+// gpiomgr
+static hal_gpio_pull_t halPull(GPIO_IDLE_TYPE t) {
+    return (t==PULL_UP)?HAL_GPIO_PULL_UP:(t==PULL_DOWN)?HAL_GPIO_PULL_DOWN:HAL_GPIO_PULL_NONE;
+}
+
+void* GPIO_define_in(const char* name, int8_t gpio, GPIO_IDLE_TYPE pull, LP_MODE_t offmode, GPIO_IDLE_TYPE offtype) {
+    return (hal_gpio_init_in(gpio, halPull(pull))==0)?getPin(gpio):NULL;
+}
+
+void* GPIO_define_out(const char* name, int8_t gpio, uint8_t initialvalue, LP_MODE_t offmode, GPIO_IDLE_TYPE offtype) {
+    return (hal_gpio_init_out(gpio, initialvalue)==0)?getPin(gpio):NULL;
+}
+
+void* GPIO_define_adc(const char* name, int8_t gpio, int chan, LP_MODE_t offmode, GPIO_IDLE_TYPE offtype) {
+    return (hal_gpio_init_in(gpio, HAL_GPIO_PULL_NONE)==0)?getPin(gpio):NULL;
+}
+
+int GPIO_read(int8_t gpio) {
+    return hal_gpio_read(gpio);
+}
+
+// a conversion takes some us
+int GPIO_readADC(int8_t gpio) {
+    struct simpin* p = getPin(gpio);
+    sim_advanceUS(20);
+    return (p!=NULL)?p->mV:0;
+}
+
+int GPIO_write(int8_t gpio, uint8_t value) {
+    hal_gpio_write(gpio, value);
+    return 0;
+}
+
+void GPIO_release(int8_t gpio) {
+    hal_gpio_deinit(gpio);
+}
+
+// sensormgr buttons
+bool SRMgr_defineButton(int8_t gpio) {
+    struct simpin* p = getPin(gpio);
+    if (p==NULL) {
+        return false;
+    }
+    hal_gpio_init_in(gpio, HAL_GPIO_PULL_UP);
+    p->button = true;
+    return true;
+}
+
+bool SRMgr_registerButtonCB(int8_t gpio, SR_BUTTON_CB_FN_t cb, void* ctx) {
+    struct simpin* p = getPin(gpio);
+    if (p==NULL || !p->button) {
+        return false;
+    }
+    p->btnCB = cb;
+    p->btnCtx = ctx;
+    return true;
+}
+
+uint32_t SRMgr_getLastButtonReleaseTS(int8_t gpio) {
+    struct simpin* p = getPin(gpio);
+    return (p!=NULL)?p->releaseTS:0;
+}
+
+uint32_t SRMgr_getLastButtonPressTS(int8_t gpio) {
+    struct simpin* p = getPin(gpio);
+    return (p!=NULL)?p->pressTS:0;
+}
+
+SR_BUTTON_PRESS_TYPE_t SRMgr_getLastButtonPressType(int8_t gpio) {
+    struct simpin* p = getPin(gpio);
+    return (p!=NULL)?p->pressType:0;
+}
+
+// pwm player
+void PWM_define(const char* name, int8_t gpio, int freq) {
+    log_debug("SIM:PWM [%s] on %d", name, gpio);
+}
+
+void PWM_play(int8_t gpio, const char* tune, int bpm) {
+    log_info("SIM:PWM %d plays [%s] at %d bpm", gpio, tune, bpm);
+}
+
+void PWM_addPWM(int8_t gpio, int freq, int dutyPct, uint32_t durationMS) {
+    log_info("SIM:PWM %d at %d Hz %d%% for %d ms", gpio, freq, dutyPct, durationMS);
+}
+
+// time manager
+uint32_t TMMgr_getRelTimeMS(void) {
+    return (uint32_t)(sim_nowUS()/1000);
+}
+
+uint32_t TMMgr_getRelTimeSecs(void) {
+    return (uint32_t)(sim_nowUS()/1000000);
+}
+
+void TMMgr_busySleep(uint32_t ms) {
+    sim_advanceUS(ms*1000);
+}
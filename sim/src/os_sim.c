@@ -0,0 +1,248 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * The mynewt OS subset used by appcorerun, on a simulated clock. There is a single thread : the main loop runs the default event 
+ * queue, and when it is empty the clock moves on to the next callout or cputime timer, which is fired (timers run their callback 
+ * as an interrupt would). The run is paced to real time, unless accelerated : then the clock jumps straight to the next event.
+ */
+#include <stdlib.h>
+#include <time.h>
+
+#include "os/os.h"
+#include "sim.h"
+
+static struct {
+    uint64_t nowUS;
+    struct os_eventq dfltq;
+    struct os_callout* callouts;        // all initialised callouts
+    struct hal_timer* timers;           // all initialised timers
+    struct timespec wallStart;
+} _os;
+
+uint64_t sim_nowUS() {
+    return _os.nowUS;
+}
+
+void sim_advanceUS(uint32_t us) {
+    _os.nowUS += us;
+}
+
+// wait in real time until the simulated time
+static void pace(uint64_t us) {
+    if (sim_isAccelerated()) {
+        return;
+    }
+    if (_os.wallStart.tv_sec==0) {
+        clock_gettime(CLOCK_MONOTONIC, &_os.wallStart);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t wallUS = (now.tv_sec-_os.wallStart.tv_sec)*1000000LL + (now.tv_nsec-_os.wallStart.tv_nsec)/1000;
+    if ((int64_t)us>wallUS) {
+        struct timespec d = { .tv_sec = (us-wallUS)/1000000, .tv_nsec = ((us-wallUS)%1000000)*1000 };
+        nanosleep(&d, NULL);
+    }
+}
+
+// Move the clock to the next callout or timer and fire it. Ends the run if there is none.
+static void fireNext() {
+    struct os_callout* nc = NULL;
+    struct hal_timer* nt = NULL;
+    for(struct os_callout* c=_os.callouts;c!=NULL;c=c->c_next) {
+        if (c->c_armed && (nc==NULL || c->c_expiryUS<nc->c_expiryUS)) {
+            nc = c;
+        }
+    }
+    for(struct hal_timer* t=_os.timers;t!=NULL;t=t->next) {
+        if (t->armed && (nt==NULL || t->expiryUS<nt->expiryUS)) {
+            nt = t;
+        }
+    }
+    if (nc==NULL && nt==NULL) {
+        sim_end("nothing left to run");
+    }
+    // timers first on a tie, as interrupts are served before the task runs
+    bool timer = (nt!=NULL && (nc==NULL || nt->expiryUS<=nc->c_expiryUS));
+    uint64_t at = timer?nt->expiryUS:nc->c_expiryUS;
+    if (at>sim_runUS()) {
+        _os.nowUS = sim_runUS();
+        sim_end("end of run time");
+    }
+    if (at>_os.nowUS) {
+        pace(at);
+        _os.nowUS = at;
+    }
+    if (timer) {
+        nt->armed = false;
+        (*nt->cb)(nt->arg);
+    } else {
+        nc->c_armed = false;
+        os_eventq_put(nc->c_evq, &nc->c_ev);
+    }
+}
+
+struct os_eventq* os_eventq_dflt_get(void) {
+    return &_os.dfltq;
+}
+
+void os_eventq_put(struct os_eventq* evq, struct os_event* ev) {
+    if (ev->ev_queued) {
+        return;
+    }
+    ev->ev_queued = 1;
+    ev->ev_next = NULL;
+    if (evq->evq_tail!=NULL) {
+        evq->evq_tail->ev_next = ev;
+    } else {
+        evq->evq_head = ev;
+    }
+    evq->evq_tail = ev;
+}
+
+static void eventq_remove(struct os_eventq* evq, struct os_event* ev) {
+    struct os_event* prev = NULL;
+    for(struct os_event* e=evq->evq_head;e!=NULL;prev=e, e=e->ev_next) {
+        if (e==ev) {
+            if (prev!=NULL) {
+                prev->ev_next = e->ev_next;
+            } else {
+                evq->evq_head = e->ev_next;
+            }
+            if (evq->evq_tail==e) {
+                evq->evq_tail = prev;
+            }
+            break;
+        }
+    }
+    ev->ev_queued = 0;
+}
+
+void os_eventq_run(struct os_eventq* evq) {
+    while(evq->evq_head==NULL) {
+        fireNext();
+    }
+    struct os_event* ev = evq->evq_head;
+    evq->evq_head = ev->ev_next;
+    if (evq->evq_head==NULL) {
+        evq->evq_tail = NULL;
+    }
+    ev->ev_queued = 0;
+    (*ev->ev_cb)(ev);
+}
+
+void os_callout_init(struct os_callout* c, struct os_eventq* evq, os_event_fn* cb, void* arg) {
+    // may be re-initialised : only link it once
+    bool linked = false;
+    for(struct os_callout* l=_os.callouts;l!=NULL;l=l->c_next) {
+        if (l==c) {
+            linked = true;
+            break;
+        }
+    }
+    struct os_callout* next = linked?c->c_next:_os.callouts;
+    memset(c, 0, sizeof(*c));
+    c->c_ev.ev_cb = cb;
+    c->c_ev.ev_arg = arg;
+    c->c_evq = evq;
+    c->c_next = next;
+    if (!linked) {
+        _os.callouts = c;
+    }
+}
+
+int os_callout_reset(struct os_callout* c, os_time_t ticks) {
+    os_callout_stop(c);
+    c->c_expiryUS = _os.nowUS + (uint64_t)ticks*(1000000/OS_TICKS_PER_SEC);
+    c->c_armed = true;
+    return OS_OK;
+}
+
+void os_callout_stop(struct os_callout* c) {
+    c->c_armed = false;
+    if (c->c_ev.ev_queued) {
+        eventq_remove(c->c_evq, &c->c_ev);
+    }
+}
+
+int os_callout_queued(struct os_callout* c) {
+    return c->c_armed;
+}
+
+os_time_t os_time_get(void) {
+    return (os_time_t)(_os.nowUS/(1000000/OS_TICKS_PER_SEC));
+}
+
+void os_time_delay(os_time_t ticks) {
+    _os.nowUS += (uint64_t)ticks*(1000000/OS_TICKS_PER_SEC);
+}
+
+uint32_t os_time_ms_to_ticks32(uint32_t ms) {
+    return ms*OS_TICKS_PER_SEC/1000;
+}
+
+uint32_t os_time_ticks_to_ms32(uint32_t ticks) {
+    return ticks*1000/OS_TICKS_PER_SEC;
+}
+
+// Each call costs 1us of cpu time, so busy waits on the uptime end
+int64_t os_get_uptime_usec(void) {
+    return (int64_t)(_os.nowUS++);
+}
+
+int os_started(void) {
+    return 1;
+}
+
+struct os_task* os_sched_get_current_task(void) {
+    static struct os_task main = { .t_name = "main" };
+    return &main;
+}
+
+uint32_t os_cputime_get32(void) {
+    return (uint32_t)_os.nowUS;
+}
+
+uint32_t os_cputime_ticks_to_usecs(uint32_t ticks) {
+    return ticks;
+}
+
+uint32_t os_cputime_usecs_to_ticks(uint32_t us) {
+    return us;
+}
+
+void os_cputime_timer_init(struct hal_timer* t, hal_timer_cb cb, void* arg) {
+    bool linked = false;
+    for(struct hal_timer* l=_os.timers;l!=NULL;l=l->next) {
+        if (l==t) {
+            linked = true;
+            break;
+        }
+    }
+    t->cb = cb;
+    t->arg = arg;
+    t->armed = false;
+    if (!linked) {
+        t->next = _os.timers;
+        _os.timers = t;
+    }
+}
+
+int os_cputime_timer_relative(struct hal_timer* t, uint32_t us) {
+    t->expiryUS = _os.nowUS + us;
+    t->armed = true;
+    return 0;
+}
+
+void os_cputime_timer_stop(struct hal_timer* t) {
+    t->armed = false;
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Battery estimate of the run : the sleep current over the whole run, the radio (time on air and RX windows of the ULs) and the 
+ * charge of the awake activities accounted by the app (MIO_AWAKE_ACCOUNTING, with MIO_AWAKE_CURRENTS_UA). The currents and the 
+ * battery capacity are the SIM_ syscfgs.
+ */
+#include "os/os.h"
+#include "awake.h"
+#include "sim.h"
+
+// uA.us to uAh
+#define UAUS_TO_UAH(c) ((c)/(3600ULL*1000000ULL))
+
+static void printUS(const char* name, uint64_t us) {
+    printf("%-16s%lu.%03lus\n", name, (unsigned long)(us/1000000), (unsigned long)((us/1000)%1000));
+}
+
+void power_sim_report() {
+    uint64_t runUS = sim_nowUS();
+    uint64_t awakeUS = 0;
+    for(int i=0;i<AWAKE_NB;i++) {
+        if (awake_getCount(i)>0) {
+            char name[24];
+            snprintf(name, sizeof(name), "awake %s", awake_getName(i));
+            printUS(name, awake_getUS(i));
+        }
+        awakeUS += awake_getUS(i);
+    }
+    printUS("awake total", awakeUS);
+    uint64_t txUS = appcore_sim_getAirtimeUS();
+    uint64_t rxUS = appcore_sim_getRxUS();
+    // the activities don't overlap (warmup waits are not in them), so the sleep current runs the rest of the time, out of radio
+    uint64_t sleepUS = (runUS>awakeUS+txUS+rxUS)?(runUS-awakeUS-txUS-rxUS):0;
+    uint64_t sleepUAH = UAUS_TO_UAH(sleepUS*MYNEWT_VAL(SIM_SLEEP_UA));
+    uint64_t txUAH = UAUS_TO_UAH(txUS*MYNEWT_VAL(SIM_TX_MA)*1000);
+    uint64_t rxUAH = UAUS_TO_UAH(rxUS*MYNEWT_VAL(SIM_RX_MA)*1000);
+    uint64_t awakeUAH = awake_getChargeUAH();
+    uint64_t totalUAH = sleepUAH+txUAH+rxUAH+awakeUAH;
+    printf("charge (mAh)    %lu.%03lu : sleep %lu.%03lu, tx %lu.%03lu, rx %lu.%03lu, awake %lu.%03lu\n", 
+        (unsigned long)(totalUAH/1000), (unsigned long)(totalUAH%1000), (unsigned long)(sleepUAH/1000), (unsigned long)(sleepUAH%1000), 
+        (unsigned long)(txUAH/1000), (unsigned long)(txUAH%1000), (unsigned long)(rxUAH/1000), (unsigned long)(rxUAH%1000), 
+        (unsigned long)(awakeUAH/1000), (unsigned long)(awakeUAH%1000));
+    if (runUS>0 && totalUAH>0) {
+        // average current, and the days a full battery lasts at this rate
+        double avgUA = (double)totalUAH*3600e6/runUS;
+        printf("average current %.1fuA\n", avgUA);
+        printf("battery life    %.0f days (%dmAh)\n", MYNEWT_VAL(SIM_BATTERY_MAH)*1000.0/avgUA/24, MYNEWT_VAL(SIM_BATTERY_MAH));
+    }
+}
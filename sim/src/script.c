@@ -0,0 +1,245 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Scenario script of the sim : one stimulus per line, at a time from the start of the run ('10s') or from the previous line ('+500ms').
+ * Units are us, ms, s (default), m, h and d. Pins are the bsp names (or numbers). '#' starts a comment.
+ *   in PIN 0|1             drive an input level
+ *   press PIN MS           press a button (active low) for MS
+ *   pulses PIN N PERIODMS  N pulses (falling then rising edge)
+ *   freq PIN HZ            square wave on PIN (0 to stop)
+ *   adc PIN MV             voltage on an analog input
+ *   temp PIN DEGC|off      DS18B20 on PIN at this temperature, or removed
+ *   dist PIN MM            ultrasonic sensor with its echo on PIN, target at MM (0 : no echo)
+ *   dl ACTION HEXBYTES     DL for an action, delivered after the next UL
+ *   active 0|1             device activated or not (app-core)
+ *   shell CMD [ARGS]       run a shell command of the app
+ *   end                    end the run
+ * A line 'TIME every PERIOD CMD ARGS' runs CMD at TIME and then every PERIOD, for activity over long (accelerated) runs.
+ */
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "os/os.h"
+#include "wyres-generic/wutils.h"
+#include "sim.h"
+
+#define MAX_LINE (160)
+
+typedef struct {
+    uint64_t atUS;
+    uint64_t periodUS;          // 0 if not repeated
+    bool done;
+    int line;
+    char cmd[12];
+    char args[MAX_LINE];
+} SCRIPT_EV_t;
+
+static const char* _cmds[] = { "in", "press", "pulses", "freq", "adc", "temp", "dist", "dl", "active", "shell", "end" };
+
+static struct {
+    SCRIPT_EV_t* evs;
+    int nbEvs;
+    struct hal_timer timer;
+} _script;
+
+// time with unit to us, -1 if bad
+int64_t script_parseTime(const char* s) {
+    char* end;
+    double v = strtod(s, &end);
+    if (end==s || v<0) {
+        return -1;
+    }
+    if (*end=='\0' || strcmp(end, "s")==0) {
+        return (int64_t)(v*1e6);
+    } else if (strcmp(end, "us")==0) {
+        return (int64_t)v;
+    } else if (strcmp(end, "ms")==0) {
+        return (int64_t)(v*1e3);
+    } else if (strcmp(end, "m")==0) {
+        return (int64_t)(v*60e6);
+    } else if (strcmp(end, "h")==0) {
+        return (int64_t)(v*3600e6);
+    } else if (strcmp(end, "d")==0) {
+        return (int64_t)(v*86400e6);
+    }
+    return -1;
+}
+
+bool script_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f==NULL) {
+        fprintf(stderr, "can't open script %s\n", path);
+        return false;
+    }
+    char buf[MAX_LINE];
+    int line = 0;
+    uint64_t last = 0;
+    bool ok = true;
+    while(fgets(buf, sizeof(buf), f)!=NULL) {
+        line++;
+        char* c = strchr(buf, '#');
+        if (c!=NULL) {
+            *c = '\0';
+        }
+        char ts[32];
+        char cmd[16];
+        int n = 0;
+        if (sscanf(buf, "%31s %15s %n", ts, cmd, &n)<2) {
+            continue;       // empty line
+        }
+        bool rel = (ts[0]=='+');
+        int64_t t = script_parseTime(rel?&ts[1]:ts);
+        int64_t period = 0;
+        if (strcmp(cmd, "every")==0) {
+            char ps[32];
+            int m = 0;
+            if (sscanf(&buf[n], "%31s %15s %n", ps, cmd, &m)<2 || (period = script_parseTime(ps))<=0) {
+                fprintf(stderr, "%s:%d: bad period\n", path, line);
+                ok = false;
+                continue;
+            }
+            n += m;
+        }
+        bool known = false;
+        for(int i=0;i<(int)(sizeof(_cmds)/sizeof(_cmds[0]));i++) {
+            known |= (strcmp(cmd, _cmds[i])==0);
+        }
+        if (t<0 || !known) {
+            fprintf(stderr, "%s:%d: bad %s\n", path, line, (t<0)?"time":"command");
+            ok = false;
+            continue;
+        }
+        _script.evs = realloc(_script.evs, (_script.nbEvs+1)*sizeof(SCRIPT_EV_t));
+        SCRIPT_EV_t* ev = &_script.evs[_script.nbEvs++];
+        ev->atUS = rel?(last+t):(uint64_t)t;
+        ev->periodUS = (uint64_t)period;
+        ev->done = false;
+        ev->line = line;
+        strcpy(ev->cmd, cmd);
+        strncpy(ev->args, &buf[n], MAX_LINE-1);
+        ev->args[MAX_LINE-1] = '\0';
+        // trailing spaces/newline
+        for(int i=strlen(ev->args)-1;i>=0 && isspace((unsigned char)ev->args[i]);i--) {
+            ev->args[i] = '\0';
+        }
+        last = ev->atUS;
+    }
+    fclose(f);
+    return ok;
+}
+
+static int pinArg(SCRIPT_EV_t* ev, const char* name) {
+    int pin = hal_sim_pinByName(name);
+    if (pin<0) {
+        log_warn("SIM:script line %d : bad pin [%s]", ev->line, name);
+    }
+    return pin;
+}
+
+static void run(SCRIPT_EV_t* ev) {
+    char p[32];
+    double v = 0;
+    double v2 = 0;
+    int n = sscanf(ev->args, "%31s %lf %lf", p, &v, &v2);
+    if (strcmp(ev->cmd, "end")==0) {
+        sim_end("end of script");
+    } else if (strcmp(ev->cmd, "shell")==0) {
+        char line[MAX_LINE];
+        strcpy(line, ev->args);
+        console_sim_exec(line);
+    } else if (strcmp(ev->cmd, "active")==0) {
+        appcore_sim_setActive(atoi(ev->args)!=0);
+    } else if (strcmp(ev->cmd, "dl")==0) {
+        // hex bytes after the action id, spaces allowed between them
+        uint8_t data[32];
+        int l = 0;
+        int nibbles = 0;
+        const char* hex = strchr(ev->args, ' ');
+        for(;hex!=NULL && *hex!='\0' && l<(int)sizeof(data);hex++) {
+            if (isxdigit((unsigned char)*hex)) {
+                int d = isdigit((unsigned char)*hex)?(*hex-'0'):(tolower((unsigned char)*hex)-'a'+10);
+                data[l] = (nibbles%2==0)?(d<<4):(data[l] | d);
+                if ((++nibbles)%2==0) {
+                    l++;
+                }
+            }
+        }
+        appcore_sim_queueDL(atoi(ev->args), data, l);
+    } else if (strcmp(ev->cmd, "temp")==0 && n==1 && strstr(ev->args, " off")!=NULL) {
+        int pin = pinArg(ev, p);
+        if (pin>=0) {
+            hal_sim_removeTemp(pin);
+        }
+    } else {
+        int pin = (n>=1)?pinArg(ev, p):-1;
+        if (pin<0 || n<2) {
+            log_warn("SIM:script line %d : bad args for %s", ev->line, ev->cmd);
+            return;
+        }
+        if (strcmp(ev->cmd, "in")==0) {
+            hal_sim_setLevel(pin, (int)v);
+        } else if (strcmp(ev->cmd, "press")==0) {
+            hal_sim_press(pin, (uint32_t)v);
+        } else if (strcmp(ev->cmd, "pulses")==0) {
+            hal_sim_pulses(pin, (uint32_t)v, (uint32_t)(v2*1000));
+        } else if (strcmp(ev->cmd, "freq")==0) {
+            hal_sim_setFreq(pin, (uint32_t)(v*1000));
+        } else if (strcmp(ev->cmd, "adc")==0) {
+            hal_sim_setADC(pin, (int)v);
+        } else if (strcmp(ev->cmd, "temp")==0) {
+            hal_sim_setTemp(pin, (int)(v*16));
+        } else if (strcmp(ev->cmd, "dist")==0) {
+            hal_sim_setDist(pin, (uint32_t)v);
+        }
+    }
+}
+
+// next line to run : the earliest, in file order on the same time
+static SCRIPT_EV_t* nextEv() {
+    SCRIPT_EV_t* next = NULL;
+    for(int i=0;i<_script.nbEvs;i++) {
+        if (!_script.evs[i].done && (next==NULL || _script.evs[i].atUS<next->atUS)) {
+            next = &_script.evs[i];
+        }
+    }
+    return next;
+}
+
+// wait for the next line, in steps as the cputime timers are 32 bits
+static void armNext() {
+    SCRIPT_EV_t* ev = nextEv();
+    if (ev!=NULL) {
+        uint64_t wait = (ev->atUS>sim_nowUS())?(ev->atUS-sim_nowUS()):0;
+        os_cputime_timer_relative(&_script.timer, (wait>INT32_MAX)?INT32_MAX:(uint32_t)wait);
+    }
+}
+
+// run the lines that are due
+static void scriptTimer(void* arg) {
+    SCRIPT_EV_t* ev;
+    while((ev = nextEv())!=NULL && ev->atUS<=sim_nowUS()) {
+        if (ev->periodUS>0) {
+            ev->atUS += ev->periodUS;
+        } else {
+            ev->done = true;
+        }
+        run(ev);
+    }
+    armNext();
+}
+
+// the lines at time 0 set up the board before the app starts
+void script_start() {
+    os_cputime_timer_init(&_script.timer, scriptTimer, NULL);
+    scriptTimer(NULL);
+}
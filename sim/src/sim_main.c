@@ -0,0 +1,101 @@
+/**
+ * Copyright 2019 Wyres
+ * Licensed under the Apache License, Version 2.0 (the "License"); 
+ * you may not use this file except in compliance with the License. 
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, 
+ * software distributed under the License is distributed on 
+ * an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, 
+ * either express or implied. See the License for the specific 
+ * language governing permissions and limitations under the License.
+*/
+/**
+ * Entry points of the native build : command line, sysinit (the pkg.init functions of the app) and the end of run report.
+ *   appcorerun_sim [-s script] [-d duration] [-x] [-q]
+ *     -s : scenario script (see script.c), none for just the periodic ULs
+ *     -d : simulated time to run for, with unit as in the script (default 1d)
+ *     -x : accelerated, the clock jumps to the next event instead of waiting in real time
+ *     -q : no logs, only the report
+ */
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "sysinit/sysinit.h"
+#include "sim.h"
+
+// pkg.init of apps/appcorerun
+extern void mod_io_init(void);
+
+static struct {
+    uint64_t runUS;
+    bool quiet;
+    bool accelerated;
+} _sim = {
+    .runUS = 86400ULL*1000000,
+};
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage : %s [-s script] [-d duration] [-x] [-q]\n", prog);
+    exit(1);
+}
+
+void mcu_sim_parse_args(int argc, char** argv) {
+    int opt;
+    const char* script = NULL;
+    while((opt = getopt(argc, argv, "s:d:xq"))!=-1) {
+        switch(opt) {
+            case 's':
+                script = optarg;
+                break;
+            case 'd': {
+                int64_t us = script_parseTime(optarg);
+                if (us<=0) {
+                    usage(argv[0]);
+                }
+                _sim.runUS = (uint64_t)us;
+                break;
+            }
+            case 'x':
+                _sim.accelerated = true;
+                break;
+            case 'q':
+                _sim.quiet = true;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (script!=NULL && !script_load(script)) {
+        exit(1);
+    }
+    script_start();
+}
+
+void sysinit(void) {
+    mod_io_init();
+}
+
+uint64_t sim_runUS() {
+    return _sim.runUS;
+}
+
+bool sim_isQuiet() {
+    return _sim.quiet;
+}
+
+bool sim_isAccelerated() {
+    return _sim.accelerated;
+}
+
+void sim_end(const char* why) {
+    uint64_t s = sim_nowUS()/1000000;
+    printf("--- %s : end of simulation (%s) after %lud %02luh%02lum%02lus\n", MYNEWT_VAL(TARGET_NAME), why, 
+        (unsigned long)(s/86400), (unsigned long)((s/3600)%24), (unsigned long)((s/60)%60), (unsigned long)(s%60));
+    appcore_sim_report();
+    power_sim_report();
+    fflush(stdout);
+    exit(0);
+}